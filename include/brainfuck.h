@@ -16,7 +16,17 @@
 #ifndef BRAINFUCK_H
 #define BRAINFUCK_H
 
+#include <signal.h>
+
 #define BRAINFUCK_TAPE_SIZE 30000
+/* The amount of inaccessible bytes on both sides of a guarded tape */
+#define BRAINFUCK_TAPE_GUARD_SIZE (1 << 20)
+/* The amount of cells reserved for a sparse tape, of which only touched pages use memory */
+#define BRAINFUCK_SPARSE_TAPE_SIZE (1 << 30)
+/* The amount of bytes buffered before output is written using the write handler */
+#define BRAINFUCK_OUTPUT_BUFFER_SIZE 4096
+/* The amount of bytes requested at once from the read handler */
+#define BRAINFUCK_INPUT_BUFFER_SIZE 4096
 /* 1: EOF leaves cell unchanged; 0: EOF == 0; 1: EOF ==  1 */
 #define BRAINFUCK_EOF_BEHAVIOR 1
 
@@ -34,8 +44,68 @@
 #	define BRAINFUCK_TOKEN_BREAK -10
 #endif
 
+/* Instructions that do not correspond to a token, created by the optimizer */
+#define BRAINFUCK_TOKEN_SET 1
+#define BRAINFUCK_TOKEN_SCAN 2
+#define BRAINFUCK_TOKEN_MULTIPLY 3
+#define BRAINFUCK_TOKEN_COUNT 4
+/* A loop that runs at most once, so its body is entered without jumping back */
+#define BRAINFUCK_TOKEN_IF 5
+
+/* 0: no optimization; 1: rewrite common loop idioms; 2: also propagate known cell values */
+#define BRAINFUCK_OPTIMIZE_DEFAULT 1
+
+#define BRAINFUCK_OP_END 0
+#define BRAINFUCK_OP_ADD 1
+#define BRAINFUCK_OP_RIGHT 2
+#define BRAINFUCK_OP_LEFT 3
+#define BRAINFUCK_OP_OUTPUT 4
+#define BRAINFUCK_OP_INPUT 5
+#define BRAINFUCK_OP_LOOP_START 6
+#define BRAINFUCK_OP_LOOP_END 7
+#define BRAINFUCK_OP_BREAK 8
+#define BRAINFUCK_OP_SET 9
+#define BRAINFUCK_OP_SCAN_RIGHT 10
+#define BRAINFUCK_OP_SCAN_LEFT 11
+#define BRAINFUCK_OP_MULTIPLY 12
+/* Moves the pointer by a signed amount without checking the bounds of the tape */
+#define BRAINFUCK_OP_MOVE 13
+/* Checks that the cells from offset up to and including argument lie on the tape */
+#define BRAINFUCK_OP_CHECK 14
+/* Replaces the cell by the amount of times adding argument to it takes to reach zero */
+#define BRAINFUCK_OP_COUNT 15
+/* Skips argument operations if the cell at offset is zero */
+#define BRAINFUCK_OP_IF 16
+
+/* The results of executing a program */
+#define BRAINFUCK_STATUS_OK 0
+/* Execution is stopped using brainfuck_execution_stop */
+#define BRAINFUCK_STATUS_STOPPED 1
+/* The program ran out of fuel or passed its deadline */
+#define BRAINFUCK_STATUS_BUDGET 2
+/* The program moved the pointer past the end of the tape */
+#define BRAINFUCK_STATUS_OVERRUN 3
+/* The program moved the pointer before the start of the tape */
+#define BRAINFUCK_STATUS_UNDERRUN 4
+/* A handler of the context failed to read input or write output */
+#define BRAINFUCK_STATUS_IO 5
+
 #define READLINE_HIST_SIZE 20
 
+/**
+ * A position in the source of a program.
+ */
+typedef struct BrainfuckPosition {
+	/**
+	 * The line of the position, counting from 1, or 0 if the position is unknown.
+	 */
+	int line;
+	/**
+	 * The column of the position, counting from 1.
+	 */
+	int column;
+} BrainfuckPosition;
+
 /**
  * Represents a brainfuck instruction.
  */
@@ -43,12 +113,35 @@ typedef struct BrainfuckInstruction {
 	/**
 	 * The difference between the value of the byte at the currect pointer and
 	 *   the value we want.
+	 * For instructions created by the optimizer this is respectively the value
+	 * 	to set the cell to, the distance to move the pointer by between the
+	 * 	cells that are checked during a scan, the factor to multiply the
+	 * 	current cell by and the step of the loop of which the iterations are
+	 * 	counted.
 	 */
 	int difference;
+	/**
+	 * The position of the cell this instruction operates on relative to the
+	 * 	pointer. Only used by <code>BRAINFUCK_TOKEN_MULTIPLY</code>, except
+	 * 	that for <code>BRAINFUCK_TOKEN_SCAN</code> it is one more than the
+	 * 	average amount of strides the scan moved in a profiled run, or 0 if
+	 * 	no profile is applied.
+	 */
+	int offset;
 	/**
 	 * The type of this instruction.
 	 */
 	char type;
+	/**
+	 * Whether this instruction is allocated from an arena, in which case it
+	 * 	is freed together with the arena instead of on its own.
+	 */
+	char pooled;
+	/**
+	 * The position in the source where this instruction starts, relative to
+	 * 	where parsing started. Unknown for instructions that are not parsed.
+	 */
+	struct BrainfuckPosition position;
 	/**
 	 * The next instruction in the linked list.
 	 */
@@ -64,6 +157,29 @@ typedef struct BrainfuckInstruction {
 	struct BrainfuckInstruction *loop;
 } BrainfuckInstruction;
 
+/**
+ * An arena hands out instructions from large blocks of memory, so that
+ * 	instructions parsed together are placed next to each other and can all be
+ * 	destroyed at once.
+ */
+typedef struct BrainfuckArena {
+	/**
+	 * The block instructions are currently allocated from, which links to the
+	 * 	blocks that were allocated before it.
+	 */
+	struct BrainfuckArenaBlock *block;
+	/**
+	 * The unmatched bracket that made the last parse into this arena fail, or
+	 * 	<code>0</code> if it succeeded.
+	 */
+	char unmatched;
+	/**
+	 * The line and column of the unmatched bracket, counted from the position
+	 * 	parsing started at.
+	 */
+	struct BrainfuckPosition unmatched_position;
+} BrainfuckArena;
+
 /**
  * The state structure contains the head and the root of the linked list containing
  * 	the instructions of the program.
@@ -77,8 +193,75 @@ typedef struct BrainfuckState {
 	 * The head instruction of the instruction linked list.
 	 */
 	struct BrainfuckInstruction *head;
+	/**
+	 * The arena the instructions of this state can be allocated from, which is
+	 * 	destroyed together with the state.
+	 */
+	struct BrainfuckArena *arena;
+	/**
+	 * Whether instructions that are not allocated from the arena have been
+	 * 	added, which have to be destroyed one by one.
+	 */
+	int unpooled;
 } BrainfuckState;
 
+/**
+ * Represents a single operation of a compiled brainfuck program.
+ */
+typedef struct BrainfuckOp {
+	/**
+	 * The operand of this operation: the amount to add or to move the pointer by,
+	 * 	the amount of repetitions for input and output or, for loops, the offset
+	 * 	relative to this operation of the matching operation.
+	 */
+	int argument;
+	/**
+	 * The position of the cell this operation operates on relative to the
+	 * 	pointer. For scans this is instead the amount of cells that are tried
+	 * 	one by one before the scan kernels are used.
+	 */
+	int offset;
+	/**
+	 * The opcode of this operation (one of the <code>BRAINFUCK_OP_*</code> values).
+	 */
+	unsigned char code;
+} BrainfuckOp;
+
+/**
+ * A compiled brainfuck program, which stores the operations of the program in
+ * 	a single contiguous array instead of a linked list, terminated by a
+ * 	<code>BRAINFUCK_OP_END</code> operation.
+ */
+typedef struct BrainfuckProgram {
+	/**
+	 * The operations of the program.
+	 */
+	struct BrainfuckOp *ops;
+	/**
+	 * The amount of operations in the program, including the final
+	 * 	<code>BRAINFUCK_OP_END</code> operation.
+	 */
+	size_t length;
+	/**
+	 * The amount of operations the <code>ops</code> array has room for.
+	 */
+	size_t capacity;
+	/**
+	 * The source position of the instruction every operation is compiled from.
+	 */
+	struct BrainfuckPosition *positions;
+	/**
+	 * The amount of times every operation is executed, which is only kept
+	 * 	when the program is profiled and <code>NULL</code> otherwise.
+	 */
+	unsigned long *counts;
+	/**
+	 * The amount of strides every scan moved in total, which is only kept
+	 * 	when the program is profiled and <code>NULL</code> otherwise.
+	 */
+	unsigned long *steps;
+} BrainfuckProgram;
+
 /**
  * The callback that will be invoked when the BRAINFUCK_TOKEN_OUTPUT token is found.
  * 
@@ -93,6 +276,27 @@ typedef int (*BrainfuckOutputHandler) (int chr);
  */
 typedef char (*BrainfuckInputHandler) (void);
 
+/**
+ * The callback that will be invoked with the buffered output of a program,
+ * 	which has the same semantics as <code>write(2)</code>.
+ *
+ * @param buffer The bytes to write.
+ * @param length The amount of bytes to write.
+ * @return The amount of bytes that are written or a negative value on error.
+ */
+typedef long (*BrainfuckWriteHandler) (const char *buffer, size_t length);
+
+/**
+ * The callback that will be invoked to fill the input buffer of a program,
+ * 	which has the same semantics as <code>read(2)</code>.
+ *
+ * @param buffer The buffer to read into.
+ * @param length The amount of bytes the buffer has room for.
+ * @return The amount of bytes that are read, <code>0</code> at the end of the
+ * 	input or a negative value on error.
+ */
+typedef long (*BrainfuckReadHandler) (char *buffer, size_t length);
+
 /**
  * This structure is used as a layer between a brainfuck program and
  * 	the outside. It allows control over input, output and memory.
@@ -107,7 +311,41 @@ typedef struct BrainfuckExecutionContext {
 	 */
 	BrainfuckInputHandler input_handler;
 	/**
-	 * An array containing the memory cells the program can use.
+	 * The callback that will be invoked with the buffered output of the program.
+	 * 	If set, output is collected in <code>output</code> and the output
+	 * 	handler is not used.
+	 */
+	BrainfuckWriteHandler write_handler;
+	/**
+	 * The output that has not been passed to the write handler yet, which is
+	 * 	flushed when it is full, before input is read and when execution ends.
+	 */
+	char *output;
+	/**
+	 * The amount of bytes in <code>output</code>.
+	 */
+	size_t output_length;
+	/**
+	 * The callback that will be invoked to fill the input buffer of the
+	 * 	program. If set, input is read in blocks into <code>input</code> and
+	 * 	the input handler is not used.
+	 */
+	BrainfuckReadHandler read_handler;
+	/**
+	 * The input that has been read but not consumed by the program yet.
+	 */
+	char *input;
+	/**
+	 * The amount of bytes in <code>input</code>.
+	 */
+	size_t input_length;
+	/**
+	 * The position of the next byte to consume in <code>input</code>.
+	 */
+	size_t input_position;
+	/**
+	 * An array containing the memory cells the program can use, each of which
+	 * 	takes <code>cell_width / 8</code> bytes.
 	 */
 	unsigned char *tape;
 	/**
@@ -119,23 +357,144 @@ typedef struct BrainfuckExecutionContext {
 	 */
 	size_t tape_size;
 	/**
-	 * A flag that, if set to true, indicates that execution should stop.
+	 * The width of the cells in bits, which is either 8, 16 or 32.
+	 */
+	int cell_width;
+	/**
+	 * Whether the tape is surrounded by guard regions, in which case compiled
+	 * 	programs do not check moves of less than
+	 * 	<code>BRAINFUCK_TAPE_GUARD_SIZE</code> cells and leaving the tape is
+	 * 	reported when a cell outside of it is accessed.
+	 */
+	int guarded;
+	/**
+	 * A flag that, if set to true, indicates that execution should stop. It is
+	 * 	checked whenever a loop jumps back. Set it using
+	 * 	<code>brainfuck_execution_stop</code>, which is atomic across threads
+	 * 	where the compiler supports it; a <code>sig_atomic_t</code> on its
+	 * 	own is only safe to set from a signal handler on the same thread.
+	 */
+	volatile sig_atomic_t shouldStop;
+	/**
+	 * The amount of operations programs may still execute in this context, or
+	 * 	a negative value if there is no limit (the default). The fuel is only
+	 * 	checked when loops jump back, so a program can run over it by at most
+	 * 	the length of the program. A program that hits a guard region is
+	 * 	charged for up to a million operations it did not get to execute.
+	 */
+	long long fuel;
+	/**
+	 * The time of a monotonic clock in milliseconds after which execution
+	 * 	stops, or <code>0</code> if there is none. Set it using
+	 * 	<code>brainfuck_set_timeout</code>.
+	 */
+	long long deadline;
+	/**
+	 * The amount of operations that may be executed before the fuel and the
+	 * 	deadline are checked again, which is already taken from the fuel.
+	 */
+	long budget;
+	/**
+	 * The position in the source of the operation the last execution failed
+	 * 	at with <code>BRAINFUCK_STATUS_OVERRUN</code>,
+	 * 	<code>BRAINFUCK_STATUS_UNDERRUN</code> or
+	 * 	<code>BRAINFUCK_STATUS_IO</code>. The line is 0 if the operation is
+	 * 	not known, like when a guard region of the tape is hit. Compiled
+	 * 	programs report moves at the operation that accesses the cell, since
+	 * 	the moves are folded into it.
+	 * After an overrun or underrun the pointer is left on the end of the tape
+	 * 	it ran off, so the context can be used again.
 	 */
-	int shouldStop;
+	struct BrainfuckPosition position;
 } BrainfuckExecutionContext;
 
 /**
- * Creates a new state.
+ * Creates a new instruction that is not linked to any other instruction.
+ *
+ * @param type The type of the instruction.
+ * @param difference The difference of the instruction.
+ * @return The instruction that is created.
+ */
+BrainfuckInstruction * brainfuck_instruction(char, int);
+
+/**
+ * Creates a new arena that allocates instructions in large blocks, so that all
+ * 	of them can be destroyed at once.
+ */
+BrainfuckArena * brainfuck_arena();
+
+/**
+ * Creates a new instruction that is not linked to any other instruction.
+ *
+ * @param arena The arena to allocate the instruction from, or <code>NULL</code> to
+ * 	allocate it on its own.
+ * @param type The type of the instruction.
+ * @param difference The difference of the instruction.
+ * @return The instruction that is created.
+ */
+BrainfuckInstruction * brainfuck_arena_instruction(struct BrainfuckArena *, char, int);
+
+/**
+ * Creates a new state, which allocates its instructions from its own arena.
  */
 BrainfuckState * brainfuck_state();
 
 /**
- * Creates a new context.
+ * Creates a new context with a tape of 8-bit cells, of which the width can be
+ * 	changed using <code>brainfuck_set_cell_width</code>.
  *
  * @param size The size of the tape.
  */
 BrainfuckExecutionContext * brainfuck_context(int);
 
+/**
+ * Creates a new context of which the tape is surrounded by inaccessible guard
+ * 	regions, so that the executors do not have to check every move of the
+ * 	pointer. The size of the tape is rounded up to a whole number of pages.
+ * Guarded contexts can be created, run and destroyed on several threads at
+ * 	once, as long as each context is used by one thread at a time.
+ * On platforms without virtual memory protection a regular context is created.
+ *
+ * @param size The minimum size of the tape.
+ */
+BrainfuckExecutionContext * brainfuck_guarded_context(int);
+
+/**
+ * Creates a new context with a guarded tape of which the memory is only
+ * 	reserved, so that pages are allocated when the program first touches them
+ * 	and programs can use a few cells far apart without paying for the cells in
+ * 	between. The pointer starts in the middle of the tape, so programs can move
+ * 	as far to the left as to the right.
+ * On platforms without virtual memory protection the tape is allocated up front.
+ *
+ * @param size The minimum size of the tape or <code>-1</code> to reserve
+ * 	<code>BRAINFUCK_SPARSE_TAPE_SIZE</code> cells.
+ */
+BrainfuckExecutionContext * brainfuck_sparse_context(int);
+
+/**
+ * Changes the width of the cells of the given context, replacing its tape by a
+ * 	cleared tape with the same amount of cells of the new width. A guarded
+ * 	tape stays guarded.
+ *
+ * @param context The context to change the width of the cells of.
+ * @param width The width of the cells in bits, which is either <code>8</code>,
+ * 	<code>16</code> or <code>32</code>.
+ * @return <code>1</code> if the width is changed, or <code>0</code> if the
+ * 	width is not supported.
+ */
+int brainfuck_set_cell_width(struct BrainfuckExecutionContext *, int);
+
+/**
+ * Limits the time the programs executed in the given context may run, which
+ * 	is checked every so many operations while loops jump back.
+ *
+ * @param context The context to limit.
+ * @param milliseconds The time the programs may run from now on, or
+ * 	<code>0</code> to remove the limit.
+ */
+void brainfuck_set_timeout(struct BrainfuckExecutionContext *, long);
+
 /**
  * Removes the given instruction from the linked list.
  * 
@@ -190,29 +549,101 @@ BrainfuckInstruction * brainfuck_insert_after(struct BrainfuckState *, struct Br
  * 	occurs and will then return a linked list containing all instructions.
  *
  * @param stream The stream to read from.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_stream(FILE *);
 
+/**
+ * Reads a character, converts it to an instruction and repeats until the EOF character
+ * 	occurs and will then return a linked list containing all instructions.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param stream The stream to read from.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_stream(struct BrainfuckArena *, FILE *);
+
 /**
  * Reads a character, converts it to an instruction and repeats until the given character
  * 	occurs and will then return a linked list containing all instructions.
  *
  * @param stream The stream to read from.
  * @param until If this character is found in the stream, we will quit reading and return.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_stream_until(FILE *, int);
 
+/**
+ * Reads a character, converts it to an instruction and repeats until the given character
+ * 	occurs and will then return a linked list containing all instructions.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param stream The stream to read from.
+ * @param until If this character is found in the stream, we will quit reading and return.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_stream_until(struct BrainfuckArena *, FILE *, int);
+
+/**
+ * Loads the file at the given path and parses it in a single pass over its
+ * 	contents, which are mapped into memory if possible or otherwise read in
+ * 	one go, like for pipes.
+ *
+ * @param path The path to the file to parse.
+ * @return The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if the file cannot be read or a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_parse_file(const char *);
+
+/**
+ * Loads the file at the given path and parses it in a single pass over its
+ * 	contents, which are mapped into memory if possible or otherwise read in
+ * 	one go, like for pipes.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param path The path to the file to parse.
+ * @return The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if the file cannot be read or a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_file(struct BrainfuckArena *, const char *);
+
+/**
+ * Writes a self-contained C translation unit to the given stream that performs
+ * 	the given instructions when compiled and run, reading input from stdin and
+ * 	writing output to stdout.
+ *
+ * @param root The start of the linked list of instructions to translate.
+ * @param stream The stream to write the C code to.
+ * @return <code>0</code> on success, otherwise <code>EOF</code>.
+ */
+int brainfuck_emit_c(struct BrainfuckInstruction *, FILE *);
+
 /**
  * Reads a character, converts it to an instruction and repeats until the string ends
  *	and will then return a linked list containing all instructions.
  *
  * @param str The string to read from.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_string(char *);
 
+/**
+ * Reads a character, converts it to an instruction and repeats until the string ends
+ *	and will then return a linked list containing all instructions.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param str The string to read from.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched, which is then stored in the
+ * 	arena.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_string(struct BrainfuckArena *, char *);
+
 /**
  * Reads a character, converts it to an instruction and repeats until the string ends
  *	and will then return a linked list containing all instructions.
@@ -221,7 +652,8 @@ BrainfuckInstruction * brainfuck_parse_string(char *);
  * @param begin The index you want to start parsing at.
  * @param end The index you want to stop parsing at.
  *	When <code>-1</code> is given, it will stop at the end of the string.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_substring(char *, int, int);
 
@@ -236,10 +668,28 @@ BrainfuckInstruction * brainfuck_parse_substring(char *, int, int);
  *	Since this will be used as counter, the value of the pointer will be increased.
  * @param end The index you want to stop parsing at.
  *	When <code>-1</code> is given, it will stop at the end of the string.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_substring_incremental(char *, int *, int);
 
+/**
+ * Reads a character, converts it to an instruction and repeats until the string ends
+ *	and will then return a linked list containing all instructions.
+ * This method uses the begin index as counter, so this variable will increase.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param str The string to read from.
+ * @param ptr The pointer to the integer holding the index you want to start parsing at.
+ *	Since this will be used as counter, the value of the pointer will be increased.
+ * @param end The index you want to stop parsing at.
+ *	When <code>-1</code> is given, it will stop at the end of the string.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched, which is then stored in the
+ * 	arena.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_substring(struct BrainfuckArena *, char *, int *, int);
+
 /**
  * Converts the given character to an instruction.
  *
@@ -248,6 +698,42 @@ BrainfuckInstruction * brainfuck_parse_substring_incremental(char *, int *, int)
  */
 BrainfuckInstruction * brainfuck_parse_character(char);
 
+/**
+ * Optimizes the given linked list of instructions in place by rewriting common
+ * 	patterns into instructions that execute faster, like loops that clear a
+ * 	cell, scan for a zero cell or add a multiple of a cell to other cells.
+ * 	Loops that run at most once become branches. From level <code>2</code>
+ * 	on, known cell values are propagated to remove loops that never run and
+ * 	stores that are never read, assuming the program starts on a zeroed tape.
+ * 	Accesses of cells that may lie off the tape are kept, so that leaving
+ * 	the tape is still reported.
+ *
+ * @param root The start of the linked list of instructions to optimize.
+ * @param level The optimization level, where <code>0</code> disables the optimizer.
+ * @return The start of the optimized linked list.
+ */
+BrainfuckInstruction * brainfuck_optimize(struct BrainfuckInstruction *, int);
+
+/**
+ * Compiles the given linked list of instructions into a program that stores its
+ * 	operations in contiguous memory and can be executed using
+ * 	<code>brainfuck_execute_program</code>.
+ *
+ * @param root The start of the linked list of instructions to compile.
+ * @return The compiled program.
+ */
+BrainfuckProgram * brainfuck_compile(struct BrainfuckInstruction *);
+
+/**
+ * Writes a listing of the operations of the given program to the given stream,
+ * 	followed by the amount of moves that are checked and the amount of moves
+ * 	of which the check is hoisted to the entry of their loop.
+ *
+ * @param program The program to list.
+ * @param stream The stream to write the listing to.
+ */
+void brainfuck_dump_program(struct BrainfuckProgram *, FILE *);
+
 /**
  * Destroys the given instruction.
  * 
@@ -262,6 +748,13 @@ void brainfuck_destroy_instruction(struct BrainfuckInstruction *);
  */
 void brainfuck_destroy_instructions(struct BrainfuckInstruction *);
 
+/**
+ * Destroys an arena and all instructions that are allocated from it.
+ *
+ * @param arena The arena to destroy.
+ */
+void brainfuck_destroy_arena(struct BrainfuckArena *);
+
 /**
  * Destroys a state.
  * 
@@ -276,6 +769,13 @@ void brainfuck_destroy_state(struct BrainfuckState *);
  */
 void brainfuck_destroy_context(struct BrainfuckExecutionContext *);
 
+/**
+ * Destroys a compiled program.
+ *
+ * @param program The program to destroy.
+ */
+void brainfuck_destroy_program(struct BrainfuckProgram *);
+
 /**
  * Executes the given linked list containing instructions.
  *
@@ -283,11 +783,99 @@ void brainfuck_destroy_context(struct BrainfuckExecutionContext *);
  * 	to execute.
  * @param context The context of this execution that contains the tape and
  *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
+ */
+int brainfuck_execute(struct BrainfuckInstruction *, struct BrainfuckExecutionContext *);
+
+/**
+ * Executes the given compiled program.
+ *
+ * @param program The program to execute.
+ * @param context The context of this execution that contains the tape and
+ *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
+ */
+int brainfuck_execute_program(struct BrainfuckProgram *, struct BrainfuckExecutionContext *);
+
+/**
+ * Executes the given compiled program while counting how often every operation
+ * 	is executed in the <code>counts</code> of the program and how far every
+ * 	scan moves in its <code>steps</code>, which are added to the counts of
+ * 	earlier runs. Programs that are not profiled run without this overhead.
+ *
+ * @param program The program to execute.
+ * @param context The context of this execution that contains the tape and
+ *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
+ */
+int brainfuck_profile_program(struct BrainfuckProgram *, struct BrainfuckExecutionContext *);
+
+/**
+ * Writes a report of the loops the given profiled program spends the most
+ * 	operations in to the given stream, ranked by those operations and
+ * 	together with the source of the loops.
+ *
+ * @param program The program that is profiled.
+ * @param source The source the program is parsed from or <code>NULL</code>
+ * 	if it is not available, in which case only positions are reported.
+ * @param limit The maximum amount of loops to report.
+ * @param stream The stream to write the report to.
+ */
+void brainfuck_profile_report(struct BrainfuckProgram *, const char *, int, FILE *);
+
+/**
+ * Writes the profile of the given profiled program to the given stream, so
+ * 	that later runs of the same source can apply it using
+ * 	<code>brainfuck_profile_apply</code>. The profile lists the entries and
+ * 	iterations of every loop, how often every branch is taken and how far
+ * 	every scan moves, keyed by their positions in the source.
+ *
+ * @param program The program that is profiled.
+ * @param stream The stream to write the profile to.
+ * @return <code>0</code> on success, otherwise <code>-1</code>.
+ */
+int brainfuck_profile_write(struct BrainfuckProgram *, FILE *);
+
+/**
+ * Applies the profile in the given stream, written by
+ * 	<code>brainfuck_profile_write</code> for the same source, to the given
+ * 	instructions, so that compiling them specializes the program for the
+ * 	behaviour seen in the profiled run. Instructions the profile does not
+ * 	know are left alone.
+ *
+ * @param root The start of the linked list of instructions to apply the
+ * 	profile to.
+ * @param stream The stream to read the profile from.
+ * @return <code>0</code> on success, otherwise <code>-1</code> if the profile
+ * 	is malformed.
+ */
+int brainfuck_profile_apply(struct BrainfuckInstruction *, FILE *);
+
+/**
+ * Executes the given linked list containing instructions by translating it
+ * 	into machine code first. On platforms the just-in-time compiler does
+ * 	not support, the program is executed by the interpreter instead.
+ *
+ * @param root The start of the linked list of instructions you want
+ * 	to execute.
+ * @param context The context of this execution that contains the tape and
+ *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
  */
-void brainfuck_execute(struct BrainfuckInstruction *, struct BrainfuckExecutionContext *);
+int brainfuck_execute_jit(struct BrainfuckInstruction *, struct BrainfuckExecutionContext *);
 
 /**
  * Stops the currently running program referenced by the given execution context.
+ * 	This is safe to call from a signal handler, and from another thread when
+ * 	the library is built by a compiler with atomic builtins (GCC and Clang).
  *
  * @param context The context of this execution that contains the tape and
  *	other execution related variables.
@@ -295,7 +883,17 @@ void brainfuck_execute(struct BrainfuckInstruction *, struct BrainfuckExecutionC
 void brainfuck_execution_stop(BrainfuckExecutionContext *);
 
 /**
- * Reads exactly one char from stdin.
+ * Passes the buffered output of the given context to its write handler.
+ *
+ * @param context The context of which the output should be flushed.
+ * @return <code>0</code> on success, otherwise <code>-1</code> if the write
+ * 	handler failed, in which case the rest of the output is dropped.
+ */
+int brainfuck_flush(BrainfuckExecutionContext *);
+
+/**
+ * Reads exactly one char from stdin and discards the rest of the line, which
+ * 	is meant for the interactive console.
  * @return The character read from stdin. 
  */
 char brainfuck_getchar(void);
@@ -0,0 +1,525 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <brainfuck.h>
+
+/* The engines programs can be run with */
+#define BENCH_ENGINE_LIST 0
+#define BENCH_ENGINE_COMPILED 1
+#define BENCH_ENGINE_JIT 2
+
+/* The maximum amount of results that are collected */
+#define BENCH_RESULTS_MAX 256
+
+/**
+ * A program of the benchmark suite.
+ */
+typedef struct BenchProgram {
+	/**
+	 * The path of the program relative to the root of the repository.
+	 */
+	const char *path;
+	/**
+	 * The input that is given to the program.
+	 */
+	const char *input;
+	/**
+	 * The FNV-1a hash of the output the program should produce.
+	 */
+	uint64_t hash;
+	/**
+	 * The amount of instructions the unoptimized program executes, which
+	 * 	is the same for every engine and optimization level, so the
+	 * 	throughput of different configurations can be compared. It is not
+	 * 	the amount of operations an engine actually executes.
+	 */
+	uint64_t reference_ops;
+} BenchProgram;
+
+/**
+ * The measurements of running a program with an engine.
+ */
+typedef struct BenchResult {
+	/**
+	 * The program that is run.
+	 */
+	const BenchProgram *program;
+	/**
+	 * The engine the program is run with.
+	 */
+	int engine;
+	/**
+	 * Whether every run produced the expected output.
+	 */
+	int correct;
+	/**
+	 * The hash of the output of the last run.
+	 */
+	uint64_t hash;
+	/**
+	 * The wall time of the fastest run in seconds.
+	 */
+	double best;
+	/**
+	 * The mean wall time of the runs in seconds.
+	 */
+	double mean;
+	/**
+	 * The peak resident set size of the process running the program in kilobytes.
+	 */
+	long rss;
+} BenchResult;
+
+/*
+ * The programs of the benchmark suite. The hashes and instruction counts are
+ * generated with the -g option.
+ */
+static const BenchProgram programs[] = {
+	{"examples/bench/bench-1.bf", "", 0x091d3d07b5b3076fULL, 268436102},
+	{"examples/bench/bench-2.bf", "", 0x05a776feab08b1daULL, 693342823},
+	{"examples/bench/easy-opt.bf", "", 0x2fb61919bf35909fULL, 4779058293},
+	{"examples/bench/endtest.bf", "", 0x39e1998b56433095ULL, 1350},
+	{"examples/bench/long.bf", "", 0xaf64874c86030f1dULL, 5587458662},
+	{"examples/bench/prttab.bf", "", 0x2fa1cddcbb0e8fe8ULL, 11314},
+	{"examples/bench/skiploop.bf", "", 0x2fb61919bf35909fULL, 18187},
+	{"examples/mandelbrot/mandelbrot.bf", "", 0x410952d238a2aac1ULL, 3018468909},
+	{"examples/mandelbrot/mandelbrot-tiny.bf", "", 0x93b7c0b5b359793aULL, 763008445},
+	{"examples/hanoi.bf", "", 0x6f363d0500735384ULL, 4395787547},
+	{"examples/math/prime.bf", "250\n", 0x1e7883312d6085d1ULL, 4817578377},
+	{"examples/sort/bubblesort-1.bf", "the quick brown fox jumps over the lazy dog", 0x0d52ca4ad7988e26ULL, 2512891},
+	{"examples/sort/insertionsort.bf", "the quick brown fox jumps over the lazy dog", 0x0d52ca4ad7988e26ULL, 1111768},
+	{"examples/sort/quicksort.bf", "the quick brown fox jumps over the lazy dog", 0x0d52ca4ad7988e26ULL, 1030132}
+};
+
+static const char *engine_names[] = {"list", "compiled", "jit"};
+
+/* The amount of times every program is run */
+static int repetitions = 3;
+/* The optimization level to run programs at */
+static int optimization_level = BRAINFUCK_OPTIMIZE_DEFAULT;
+/* The engines to run programs with, or zero for the default engines */
+static int engines = 0;
+/* The path to write the results as JSON to */
+static char *json_path = "bench.json";
+
+/* The output of the current run, which is captured in memory */
+static char *output = NULL;
+static size_t output_length = 0;
+static size_t output_capacity = 0;
+
+/* The input of the current run */
+static const char *input = NULL;
+static size_t input_position = 0;
+
+/**
+ * Print the usage message of this program.
+ *
+ * @param name The name of this program (given by argv[0]).
+ */
+void print_usage(char *name) {
+	fprintf(stderr, "usage: %s [-hg] [-n repetitions] [-O level] [-e engine] [-o out.json]\n", name);
+	fprintf(stderr, "\t-n\tset the amount of runs of every program (default 3)\n");
+	fprintf(stderr, "\t-O\tset the optimization level (default %d)\n", BRAINFUCK_OPTIMIZE_DEFAULT);
+	fprintf(stderr, "\t-e\trun with the list, compiled or jit engine, which can be repeated (default compiled and jit)\n");
+	fprintf(stderr, "\t-o\twrite the results as JSON to the given path (default bench.json)\n");
+	fprintf(stderr, "\t-g\tprint the expected hashes and reference instruction counts of the programs\n");
+	fprintf(stderr, "\t-h\tshow a help message\n");
+	fprintf(stderr, "Programs are found relative to the working directory, which should be the root of the repository.\n");
+}
+
+/**
+ * Append the given output of a program to the output of the current run.
+ *
+ * @param buffer The bytes to write.
+ * @param length The amount of bytes to write.
+ * @return The amount of bytes that are written.
+ */
+long write_memory(const char *buffer, size_t length) {
+	if (output_length + length > output_capacity) {
+		output_capacity = output_length + length > 2 * output_capacity ? output_length + length :
+			2 * output_capacity;
+		output = (char *) realloc(output, output_capacity);
+	}
+	memcpy(output + output_length, buffer, length);
+	output_length += length;
+	return (long) length;
+}
+
+/**
+ * Read the input of the current run into the given buffer.
+ *
+ * @param buffer The buffer to read into.
+ * @param length The amount of bytes the buffer has room for.
+ * @return The amount of bytes that are read or 0 at the end of the input.
+ */
+long read_memory(char *buffer, size_t length) {
+	size_t remaining = strlen(input + input_position);
+	if (length > remaining)
+		length = remaining;
+	memcpy(buffer, input + input_position, length);
+	input_position += length;
+	return (long) length;
+}
+
+/**
+ * Compute the FNV-1a hash of the given bytes.
+ *
+ * @param buffer The bytes to hash.
+ * @param length The amount of bytes.
+ * @return The hash of the bytes.
+ */
+uint64_t hash(const char *buffer, size_t length) {
+	uint64_t result = 0xcbf29ce484222325ULL;
+	size_t i;
+	for (i = 0; i < length; i++) {
+		result ^= (unsigned char) buffer[i];
+		result *= 0x100000001b3ULL;
+	}
+	return result;
+}
+
+/**
+ * Return the current time of a monotonic clock in seconds.
+ */
+double now() {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+/**
+ * Count the instructions the given unoptimized program executes with the given
+ * 	input, where every loop test, including the one at the end of every
+ * 	iteration, counts as an instruction.
+ *
+ * @param root The start of the linked list of instructions to count.
+ * @param data The input of the program.
+ * @return The amount of instructions executed or 0 if the program leaves the tape.
+ */
+uint64_t count_ops(BrainfuckInstruction *root, const char *data) {
+	static unsigned char tape[BRAINFUCK_TAPE_SIZE];
+	BrainfuckInstruction *instruction = root, **loops = NULL;
+	size_t depth = 0, capacity = 0;
+	long index = 0;
+	uint64_t result = 0;
+	int i;
+
+	memset(tape, 0, sizeof(tape));
+	while (1) {
+		if (instruction == NULL || instruction->type == BRAINFUCK_TOKEN_LOOP_END) {
+			if (depth == 0)
+				break;
+			result++;
+			if (tape[index]) {
+				instruction = loops[depth - 1]->loop;
+			} else {
+				instruction = loops[--depth]->next;
+			}
+			continue;
+		}
+		result++;
+		switch (instruction->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+			tape[index] += instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_MINUS:
+			tape[index] -= instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+			index += instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			index -= instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_INPUT:
+			for (i = 0; i < instruction->difference && *data != '\0'; i++)
+				tape[index] = (unsigned char) *data++;
+			if (i < instruction->difference && BRAINFUCK_EOF_BEHAVIOR != 1)
+				tape[index] = BRAINFUCK_EOF_BEHAVIOR;
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+			if (!tape[index])
+				break;
+			if (depth == capacity) {
+				capacity = capacity ? capacity * 2 : 16;
+				loops = (BrainfuckInstruction **) realloc(loops, capacity * sizeof(BrainfuckInstruction *));
+			}
+			loops[depth++] = instruction;
+			instruction = instruction->loop;
+			continue;
+		default:
+			break;
+		}
+		if (index < 0 || index >= BRAINFUCK_TAPE_SIZE) {
+			result = 0;
+			break;
+		}
+		instruction = instruction->next;
+	}
+	free(loops);
+	return result;
+}
+
+/**
+ * Run the given program the configured amount of times with the given engine
+ * 	and check its output every time.
+ *
+ * @param program The program to run.
+ * @param engine The engine to run the program with.
+ * @param level The optimization level to run the program at.
+ * @param count The amount of times to run the program.
+ * @param result The result to fill in.
+ * @return EXIT_SUCCESS if the program could be loaded, otherwise EXIT_FAILURE.
+ */
+int run_program(const BenchProgram *program, int engine, int level, int count, BenchResult *result) {
+	BrainfuckState *state = brainfuck_state();
+	BrainfuckInstruction *root = brainfuck_arena_parse_file(state->arena, program->path);
+	BrainfuckExecutionContext *context;
+	BrainfuckProgram *compiled;
+	double start, elapsed, total = 0;
+	int i, status;
+
+	if (root == NULL) {
+		fprintf(stderr, "error: failed to load %s\n", program->path);
+		brainfuck_destroy_state(state);
+		return EXIT_FAILURE;
+	}
+	brainfuck_add(state, brainfuck_optimize(root, level));
+	result->correct = 1;
+	result->best = 0;
+	for (i = 0; i < count; i++) {
+		context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+		context->write_handler = &write_memory;
+		context->read_handler = &read_memory;
+		output_length = 0;
+		input = program->input;
+		input_position = 0;
+
+		start = now();
+		if (engine == BENCH_ENGINE_LIST) {
+			status = brainfuck_execute(state->root, context);
+		} else if (engine == BENCH_ENGINE_COMPILED) {
+			compiled = brainfuck_compile(state->root);
+			status = brainfuck_execute_program(compiled, context);
+			brainfuck_destroy_program(compiled);
+		} else {
+			status = brainfuck_execute_jit(state->root, context);
+		}
+		elapsed = now() - start;
+		brainfuck_destroy_context(context);
+
+		total += elapsed;
+		if (i == 0 || elapsed < result->best)
+			result->best = elapsed;
+		result->hash = hash(output, output_length);
+		if (result->hash != program->hash || status != BRAINFUCK_STATUS_OK)
+			result->correct = 0;
+	}
+	result->mean = total / count;
+	brainfuck_destroy_state(state);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Run the given program in a separate process, so its peak memory usage can
+ * 	be measured and a program that crashes does not end the benchmark.
+ *
+ * @param program The program to run.
+ * @param engine The engine to run the program with.
+ * @param result The result to fill in.
+ * @return EXIT_SUCCESS if the program ran, otherwise EXIT_FAILURE.
+ */
+int run_isolated(const BenchProgram *program, int engine, BenchResult *result) {
+	struct rusage usage;
+	int fds[2], status;
+	pid_t pid;
+
+	result->program = program;
+	result->engine = engine;
+	result->correct = 0;
+	if (pipe(fds) != 0) {
+		perror("error: pipe");
+		return EXIT_FAILURE;
+	}
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("error: fork");
+		return EXIT_FAILURE;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		status = run_program(program, engine, optimization_level, repetitions, result);
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		result->rss = usage.ru_maxrss / 1024;
+#else
+		result->rss = usage.ru_maxrss;
+#endif
+		if (status == EXIT_SUCCESS && write(fds[1], result, sizeof(BenchResult)) != sizeof(BenchResult))
+			status = EXIT_FAILURE;
+		_exit(status);
+	}
+	close(fds[1]);
+	if (read(fds[0], result, sizeof(BenchResult)) != sizeof(BenchResult))
+		result->correct = -1;
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	return result->correct >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS ?
+		EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Print the expected hash and instruction count of every program, computed
+ * 	with the unoptimized list engine, in the format of the program table.
+ *
+ * @return EXIT_SUCCESS if all programs ran, otherwise EXIT_FAILURE.
+ */
+int generate() {
+	BrainfuckInstruction *root;
+	BenchResult result;
+	size_t i;
+
+	for (i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+		root = brainfuck_parse_file(programs[i].path);
+		if (root == NULL || run_program(&programs[i], BENCH_ENGINE_LIST, 0, 1, &result) != EXIT_SUCCESS) {
+			fprintf(stderr, "error: failed to load %s\n", programs[i].path);
+			return EXIT_FAILURE;
+		}
+		printf("\t{\"%s\", \"", programs[i].path);
+		fwrite(programs[i].input, 1, strcspn(programs[i].input, "\n"), stdout);
+		printf("%s\", 0x%016llxULL, %llu},\n", strchr(programs[i].input, '\n') ? "\\n" : "",
+			(unsigned long long) result.hash, (unsigned long long) count_ops(root, programs[i].input));
+		brainfuck_destroy_instructions(root);
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Write the given results as JSON to the path given by the -o option.
+ *
+ * @param results The results to write.
+ * @param count The amount of results.
+ * @return EXIT_SUCCESS if the results are written, otherwise EXIT_FAILURE.
+ */
+int write_json(BenchResult *results, size_t count) {
+	FILE *out = fopen(json_path, "w");
+	size_t i;
+	if (out == NULL) {
+		fprintf(stderr, "error: failed to open file %s\n", json_path);
+		return EXIT_FAILURE;
+	}
+	fprintf(out, "{\n\t\"repetitions\": %d,\n\t\"level\": %d,\n\t\"results\": [", repetitions, optimization_level);
+	for (i = 0; i < count; i++) {
+		fprintf(out, "%s\n\t\t{\"program\": \"%s\", \"engine\": \"%s\", \"correct\": %s, ",
+			i > 0 ? "," : "", results[i].program->path, engine_names[results[i].engine],
+			results[i].correct > 0 ? "true" : "false");
+		fprintf(out, "\"best\": %.6f, \"mean\": %.6f, \"reference_ops\": %llu, \"reference_ops_per_second\": %.0f, "
+			"\"peak_rss_kb\": %ld}", results[i].best, results[i].mean,
+			(unsigned long long) results[i].program->reference_ops,
+			results[i].best > 0 ? (double) results[i].program->reference_ops / results[i].best : 0.0,
+			results[i].rss);
+	}
+	fprintf(out, "\n\t]\n}\n");
+	if (fclose(out) != 0) {
+		fprintf(stderr, "error: failed to write file %s\n", json_path);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Main entry point of the benchmark, which runs every program of the suite
+ * 	with the selected engines and reports how fast they run.
+ *
+ * @param argc The amount of arguments given.
+ * @param argv The array with arguments.
+ */
+int main(int argc, char *argv[]) {
+	BenchResult results[BENCH_RESULTS_MAX], *result;
+	size_t count = 0, i;
+	int c, engine, status = EXIT_SUCCESS;
+
+	while ((c = getopt(argc, argv, "hgn:O:e:o:")) != -1) {
+		switch (c) {
+		case 'n':
+			repetitions = atoi(optarg);
+			if (repetitions < 1) {
+				fprintf(stderr, "error: invalid amount of repetitions %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'O':
+			optimization_level = atoi(optarg);
+			break;
+		case 'e':
+			for (engine = 0; engine < 3 && strcmp(optarg, engine_names[engine]) != 0; engine++) { }
+			if (engine == 3) {
+				fprintf(stderr, "error: unknown engine %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			engines |= 1 << engine;
+			break;
+		case 'o':
+			json_path = optarg;
+			break;
+		case 'g':
+			return generate();
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (engines == 0)
+		engines = 1 << BENCH_ENGINE_COMPILED | 1 << BENCH_ENGINE_JIT;
+
+	printf("%-40s %-8s %10s %10s %14s %10s %10s %s\n", "program", "engine", "best (s)", "mean (s)", "ref ops",
+		"ref Mops/s", "rss (KB)", "status");
+	for (i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+		for (engine = 0; engine < 3; engine++) {
+			if (!(engines & 1 << engine) || count == BENCH_RESULTS_MAX)
+				continue;
+			result = &results[count++];
+			if (run_isolated(&programs[i], engine, result) != EXIT_SUCCESS) {
+				printf("%-40s %-8s %10s %10s %14s %10s %10s %s\n", programs[i].path, engine_names[engine],
+					"-", "-", "-", "-", "-", "FAILED");
+				result->correct = 0;
+				result->best = result->mean = 0;
+				result->rss = 0;
+				status = EXIT_FAILURE;
+				continue;
+			}
+			printf("%-40s %-8s %10.4f %10.4f %14llu %10.1f %10ld %s\n", programs[i].path, engine_names[engine],
+				result->best, result->mean, (unsigned long long) programs[i].reference_ops,
+				result->best > 0 ? (double) programs[i].reference_ops / result->best / 1e6 : 0.0, result->rss,
+				result->correct ? "ok" : "WRONG OUTPUT");
+			if (!result->correct)
+				status = EXIT_FAILURE;
+		}
+	}
+	if (write_json(results, count) != EXIT_SUCCESS)
+		status = EXIT_FAILURE;
+	return status;
+}
@@ -18,22 +18,139 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 #include <assert.h>
 
+/*
+ * Source files are mapped into memory where possible, so they can be parsed
+ * 	without copying them. Other platforms read the file in one go instead.
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define BRAINFUCK_PARSE_MMAP
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
 #include <brainfuck.h>
 
+#include "budget.h"
+#include "count.h"
+#include "io.h"
+#include "scan.h"
+#include "tape.h"
+
+/**
+ * Creates a new instruction that is not linked to any other instruction.
+ *
+ * @param type The type of the instruction.
+ * @param difference The difference of the instruction.
+ * @return The instruction that is created.
+ */
+BrainfuckInstruction * brainfuck_instruction(char type, int difference) {
+	BrainfuckInstruction *instruction = (BrainfuckInstruction *) malloc(sizeof(BrainfuckInstruction));
+	instruction->difference = difference;
+	instruction->offset = 0;
+	instruction->type = type;
+	instruction->pooled = 0;
+	instruction->position.line = 0;
+	instruction->position.column = 0;
+	instruction->next = 0;
+	instruction->previous = 0;
+	instruction->loop = 0;
+	return instruction;
+}
+
 /**
- * Creates a new state.
+ * A block of instructions that an arena allocates from.
+ */
+typedef struct BrainfuckArenaBlock {
+	/**
+	 * The block that was allocated before this block.
+	 */
+	struct BrainfuckArenaBlock *previous;
+	/**
+	 * The amount of instructions that have been handed out from this block.
+	 */
+	size_t used;
+	/**
+	 * The amount of instructions this block has room for.
+	 */
+	size_t capacity;
+	/**
+	 * The instructions of this block, which extend beyond the end of the structure.
+	 */
+	BrainfuckInstruction instructions[1];
+} BrainfuckArenaBlock;
+
+/**
+ * Creates a new arena that allocates instructions in large blocks, so that all
+ * 	of them can be destroyed at once.
+ */
+BrainfuckArena * brainfuck_arena() {
+	BrainfuckArena *arena = (BrainfuckArena *) malloc(sizeof(BrainfuckArena));
+	arena->block = 0;
+	arena->unmatched = 0;
+	arena->unmatched_position.line = 0;
+	arena->unmatched_position.column = 0;
+	return arena;
+}
+
+/**
+ * Creates a new instruction that is not linked to any other instruction.
+ *
+ * @param arena The arena to allocate the instruction from, or <code>NULL</code> to
+ * 	allocate it on its own.
+ * @param type The type of the instruction.
+ * @param difference The difference of the instruction.
+ * @return The instruction that is created.
+ */
+BrainfuckInstruction * brainfuck_arena_instruction(BrainfuckArena *arena, char type, int difference) {
+	BrainfuckArenaBlock *block;
+	BrainfuckInstruction *instruction;
+	size_t capacity;
+	if (arena == NULL)
+		return brainfuck_instruction(type, difference);
+	block = arena->block;
+	if (block == NULL || block->used == block->capacity) {
+		/* Blocks grow with the program, so small programs stay small */
+		capacity = block == NULL ? 256 : block->capacity < 65536 ? block->capacity * 2 : 65536;
+		block = (BrainfuckArenaBlock *) malloc(sizeof(BrainfuckArenaBlock) +
+				(capacity - 1) * sizeof(BrainfuckInstruction));
+		block->previous = arena->block;
+		block->used = 0;
+		block->capacity = capacity;
+		arena->block = block;
+	}
+	instruction = &block->instructions[block->used++];
+	instruction->difference = difference;
+	instruction->offset = 0;
+	instruction->type = type;
+	instruction->pooled = 1;
+	instruction->position.line = 0;
+	instruction->position.column = 0;
+	instruction->next = 0;
+	instruction->previous = 0;
+	instruction->loop = 0;
+	return instruction;
+}
+
+/**
+ * Creates a new state, which allocates its instructions from its own arena.
  */
 BrainfuckState * brainfuck_state() {
 	BrainfuckState *state = (BrainfuckState *) malloc(sizeof(BrainfuckState));
 	state->root = 0;
 	state->head = 0;
+	state->arena = brainfuck_arena();
+	state->unpooled = 0;
 	return state;
 }
 
 /**
- * Creates a new brainfuck context.
+ * Creates a new brainfuck context with a tape of 8-bit cells, of which the
+ * 	width can be changed using <code>brainfuck_set_cell_width</code>.
  *
  * @param size The size of the tape.
  */
@@ -48,13 +165,87 @@ BrainfuckExecutionContext * brainfuck_context(int size) {
 	
 	context->output_handler = &putchar;
 	context->input_handler = &brainfuck_getchar;
+	context->write_handler = NULL;
+	context->output = (char *) malloc(BRAINFUCK_OUTPUT_BUFFER_SIZE);
+	context->output_length = 0;
+	context->read_handler = NULL;
+	context->input = (char *) malloc(BRAINFUCK_INPUT_BUFFER_SIZE);
+	context->input_length = 0;
+	context->input_position = 0;
 	context->tape = tape;
 	context->tape_index = 0;
 	context->tape_size = size;
+	context->cell_width = 8;
+	context->guarded = 0;
 	context->shouldStop = 0;
+	context->fuel = -1;
+	context->deadline = 0;
+	context->budget = 0;
+	context->position.line = 0;
+	context->position.column = 0;
+	return context;
+}
+
+/**
+ * Creates a new brainfuck context of which the tape is surrounded by guard
+ * 	regions, falling back to a regular tape where that is not supported.
+ * 	Guarded contexts can be used on several threads at once, one thread per
+ * 	context.
+ *
+ * @param size The minimum size of the tape.
+ */
+BrainfuckExecutionContext * brainfuck_guarded_context(int size) {
+	BrainfuckExecutionContext *context = brainfuck_context(0);
+	if (size < 0)
+		size = BRAINFUCK_TAPE_SIZE;
+	free(context->tape);
+	context->tape_size = size;
+	if (!brainfuck_tape_guard(context))
+		context->tape = (unsigned char *) calloc(size, sizeof(char));
 	return context;
 }
 
+/**
+ * Creates a new brainfuck context with a guarded tape of which pages are only
+ * 	allocated when they are first touched, starting in the middle of the tape.
+ *
+ * @param size The minimum size of the tape or <code>-1</code> to reserve
+ * 	<code>BRAINFUCK_SPARSE_TAPE_SIZE</code> cells.
+ */
+BrainfuckExecutionContext * brainfuck_sparse_context(int size) {
+	BrainfuckExecutionContext *context = brainfuck_guarded_context(size < 0 ?
+		BRAINFUCK_SPARSE_TAPE_SIZE : size);
+	context->tape_index = (int) (context->tape_size / 2);
+	return context;
+}
+
+/**
+ * Changes the width of the cells of the given context, replacing its tape by a
+ * 	cleared tape with the same amount of cells of the new width. A guarded
+ * 	tape stays guarded.
+ *
+ * @param context The context to change the width of the cells of.
+ * @param width The width of the cells in bits, which is either <code>8</code>,
+ * 	<code>16</code> or <code>32</code>.
+ * @return <code>1</code> if the width is changed, or <code>0</code> if the
+ * 	width is not supported.
+ */
+int brainfuck_set_cell_width(BrainfuckExecutionContext *context, int width) {
+	if (width != 8 && width != 16 && width != 32)
+		return 0;
+	if (context->guarded) {
+		brainfuck_tape_unguard(context);
+		context->cell_width = width;
+		if (brainfuck_tape_guard(context))
+			return 1;
+	} else {
+		free(context->tape);
+		context->cell_width = width;
+	}
+	context->tape = (unsigned char *) calloc(context->tape_size, width / 8);
+	return 1;
+}
+
 /**
  * Removes the given instruction from the linked list.
  * 
@@ -85,6 +276,8 @@ BrainfuckInstruction * brainfuck_add(BrainfuckState *state,
 		BrainfuckInstruction *instruction) {
 	if (state == NULL || instruction == NULL)
 		return NULL;
+	if (!instruction->pooled)
+		state->unpooled = 1;
 	instruction->previous = state->head;
 	if (state->head != NULL) 
 		state->head->next = instruction;
@@ -112,6 +305,8 @@ BrainfuckInstruction * brainfuck_add_front(BrainfuckState *state,
 		BrainfuckInstruction *instruction) {
 	if (state == NULL || instruction == NULL)
 		return NULL;
+	if (!instruction->pooled)
+		state->unpooled = 1;
 	instruction->previous = 0;
 	BrainfuckInstruction *iter = instruction;
 	while (iter != NULL) {
@@ -139,6 +334,8 @@ BrainfuckInstruction * brainfuck_insert_before(BrainfuckState *state, BrainfuckI
 		BrainfuckInstruction *instruction) {
 	if (state == NULL || before == NULL || instruction == NULL)
 			return NULL;
+	if (!instruction->pooled)
+		state->unpooled = 1;
 	BrainfuckInstruction *previous = before->previous;
 	BrainfuckInstruction *iter = instruction;
 	while (iter != NULL) {
@@ -170,6 +367,8 @@ BrainfuckInstruction * brainfuck_insert_after(BrainfuckState *state, BrainfuckIn
 			BrainfuckInstruction *instruction) {
 		if (state == NULL || after == NULL || instruction == NULL)
 			return NULL;
+		if (!instruction->pooled)
+			state->unpooled = 1;
 		BrainfuckInstruction *next = after->next;
 		BrainfuckInstruction *iter = instruction;
 
@@ -190,16 +389,176 @@ BrainfuckInstruction * brainfuck_insert_after(BrainfuckState *state, BrainfuckIn
 		return instruction;
 }
 
+/**
+ * Determines whether the given character is a command rather than a comment.
+ *
+ * @param c The character to check.
+ * @return <code>1</code> if the character is a command, otherwise <code>0</code>.
+ */
+static int brainfuck_is_command(char c) {
+	switch (c) {
+	case BRAINFUCK_TOKEN_PLUS:
+	case BRAINFUCK_TOKEN_MINUS:
+	case BRAINFUCK_TOKEN_NEXT:
+	case BRAINFUCK_TOKEN_PREVIOUS:
+	case BRAINFUCK_TOKEN_OUTPUT:
+	case BRAINFUCK_TOKEN_INPUT:
+	case BRAINFUCK_TOKEN_LOOP_START:
+	case BRAINFUCK_TOKEN_LOOP_END:
+	case BRAINFUCK_TOKEN_BREAK:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Returns the command that undoes the given command, which are combined with
+ * 	each other in runs.
+ *
+ * @param c The command to return the opposite of.
+ * @return The opposite command or <code>0</code> if it has none.
+ */
+static char brainfuck_opposite(char c) {
+	switch (c) {
+	case BRAINFUCK_TOKEN_PLUS:
+		return BRAINFUCK_TOKEN_MINUS;
+	case BRAINFUCK_TOKEN_MINUS:
+		return BRAINFUCK_TOKEN_PLUS;
+	case BRAINFUCK_TOKEN_NEXT:
+		return BRAINFUCK_TOKEN_PREVIOUS;
+	case BRAINFUCK_TOKEN_PREVIOUS:
+		return BRAINFUCK_TOKEN_NEXT;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * An opening bracket whose loop is still being parsed.
+ */
+typedef struct BrainfuckBracket {
+	/* The loop instruction of the bracket */
+	BrainfuckInstruction *loop;
+	/* The index of the bracket in the source */
+	int position;
+} BrainfuckBracket;
+
+/**
+ * The lines of the source that have been counted while parsing.
+ */
+typedef struct BrainfuckLines {
+	/* The index up to which the lines have been counted */
+	int scanned;
+	/* The line at that index */
+	int line;
+	/* The index of the first character of that line */
+	int start;
+} BrainfuckLines;
+
+/**
+ * Sets the position of the given instruction, which starts at the given index
+ * 	of the source. Lines are only counted from where the previous
+ * 	instruction started, so every character is looked at once.
+ *
+ * @param str The source that is parsed.
+ * @param index The index of the first character of the instruction.
+ * @param lines The lines that have been counted so far.
+ * @param instruction The instruction to set the position of.
+ */
+static void brainfuck_parse_position(const char *str, int index, BrainfuckLines *lines,
+		BrainfuckInstruction *instruction) {
+	const char *newline;
+	while ((newline = (const char *) memchr(str + lines->scanned, '\n', index - lines->scanned)) != NULL) {
+		lines->line++;
+		lines->scanned = lines->start = (int) (newline - str) + 1;
+	}
+	lines->scanned = index;
+	instruction->position.line = lines->line;
+	instruction->position.column = index - lines->start + 1;
+}
+
+/**
+ * Stores an unmatched bracket together with its line and column, which are
+ * 	counted from the position parsing started at, in the given arena.
+ *
+ * @param arena The arena parsed into, or <code>NULL</code> if the error is
+ * 	not stored.
+ * @param str The source that is parsed.
+ * @param begin The index parsing started at.
+ * @param position The index of the unmatched bracket.
+ * @param bracket The unmatched bracket.
+ */
+static void brainfuck_parse_error(BrainfuckArena *arena, const char *str, int begin, int position, char bracket) {
+	int line = 1, column = 1;
+	if (arena == NULL)
+		return;
+	for (; begin < position; begin++) {
+		if (str[begin] == '\n') {
+			line++;
+			column = 1;
+		} else {
+			column++;
+		}
+	}
+	arena->unmatched = bracket;
+	arena->unmatched_position.line = line;
+	arena->unmatched_position.column = column;
+}
+
+/**
+ * Reads the remainder of the given stream into memory using as few reads as
+ * 	possible.
+ *
+ * @param stream The stream to read from.
+ * @param length The pointer to store the amount of bytes that are read in.
+ * @return The bytes that are read, which should be freed by the caller.
+ */
+static char * brainfuck_read_stream(FILE *stream, size_t *length) {
+	size_t capacity = 65536, count;
+	char *buffer = (char *) malloc(capacity);
+	*length = 0;
+	while ((count = fread(buffer + *length, 1, capacity - *length, stream)) > 0) {
+		*length += count;
+		if (*length == capacity) {
+			capacity *= 2;
+			buffer = (char *) realloc(buffer, capacity);
+		}
+	}
+	return buffer;
+}
+
 /**
  * Reads a character, converts it to an instruction and repeats until the EOF character
  * 	occurs and will then return a linked list containing all instructions.
+ * The stream is read into memory in one go and parsed from there.
  *
  * @param head The head of the linked list that contains the instructions. 
  * @param stream The stream to read from.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_stream(FILE *stream) {
-	return brainfuck_parse_stream_until(stream, EOF);
+	return brainfuck_arena_parse_stream(NULL, stream);
+}
+
+/**
+ * Reads a character, converts it to an instruction and repeats until the EOF character
+ * 	occurs and will then return a linked list containing all instructions.
+ * The stream is read into memory in one go and parsed from there.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param stream The stream to read from.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_stream(BrainfuckArena *arena, FILE *stream) {
+	size_t length;
+	int begin = 0;
+	char *source = brainfuck_read_stream(stream, &length);
+	BrainfuckInstruction *root = brainfuck_arena_parse_substring(arena, source, &begin, (int) length);
+	free(source);
+	return root;
 }
 
 /**
@@ -208,66 +567,100 @@ BrainfuckInstruction * brainfuck_parse_stream(FILE *stream) {
  *
  * @param stream The stream to read from.
  * @param until If this character is found in the stream, we will quit reading and return.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_stream_until(FILE *stream, const int until) {
-	BrainfuckInstruction *instruction = (BrainfuckInstruction *) malloc(sizeof(BrainfuckInstruction));
-	instruction->next = 0;
-	instruction->loop = 0;
-	BrainfuckInstruction *root = instruction;
-	char ch;
-	char temp;
-	while ((ch = fgetc(stream)) != until) {
-		if (ch == EOF || feof(stream)) { break; }
-		instruction->type = ch;
-		instruction->difference = 1;
-		switch(ch) {
-		case BRAINFUCK_TOKEN_PLUS:
-		case BRAINFUCK_TOKEN_MINUS:
-			while ((temp = fgetc(stream)) != until && (temp == BRAINFUCK_TOKEN_PLUS 
-					|| temp == BRAINFUCK_TOKEN_MINUS)) {
-				if (temp == ch) {
-					instruction->difference++;
-				} else {
-					instruction->difference--;
-				}
-			}
-			ungetc(temp, stream);
-			break;
-		case BRAINFUCK_TOKEN_NEXT:
-		case BRAINFUCK_TOKEN_PREVIOUS:
-			while ((temp = fgetc(stream)) != until && (temp == BRAINFUCK_TOKEN_NEXT 
-					|| temp == BRAINFUCK_TOKEN_PREVIOUS)) {
-				if (temp == ch) {
-					instruction->difference++;
-				} else {
-					instruction->difference--;
-				}
-			}
-			ungetc(temp, stream);
-			break;
-		case BRAINFUCK_TOKEN_OUTPUT:
-		case BRAINFUCK_TOKEN_INPUT:
-			while ((temp = fgetc(stream)) != until && temp == ch)
-				instruction->difference++;
-			ungetc(temp, stream);
-			break;
-		case BRAINFUCK_TOKEN_LOOP_START:
-			instruction->loop = brainfuck_parse_stream_until(stream, until);
-			break;
-		case BRAINFUCK_TOKEN_LOOP_END:
+	return brainfuck_arena_parse_stream_until(NULL, stream, until);
+}
+
+/**
+ * Reads a character, converts it to an instruction and repeats until the given character
+ * 	occurs and will then return a linked list containing all instructions.
+ *
+ * The characters up to the given one are read into memory and parsed from there.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param stream The stream to read from.
+ * @param until If this character is found in the stream, we will quit reading and return.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_stream_until(BrainfuckArena *arena, FILE *stream,
+		const int until) {
+	size_t length = 0, capacity = 256;
+	char *source = (char *) malloc(capacity);
+	int begin = 0;
+	int ch;
+	while ((ch = fgetc(stream)) != until && ch != EOF) {
+		if (length == capacity) {
+			capacity *= 2;
+			source = (char *) realloc(source, capacity);
+		}
+		source[length++] = (char) ch;
+	}
+	BrainfuckInstruction *root = brainfuck_arena_parse_substring(arena, source, &begin, (int) length);
+	free(source);
+	return root;
+}
+
+/**
+ * Loads the file at the given path and parses it in a single pass over its
+ * 	contents, which are mapped into memory if possible or otherwise read in
+ * 	one go, like for pipes.
+ *
+ * @param path The path to the file to parse.
+ * @return The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if the file cannot be read or a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_parse_file(const char *path) {
+	return brainfuck_arena_parse_file(NULL, path);
+}
+
+/**
+ * Loads the file at the given path and parses it in a single pass over its
+ * 	contents, which are mapped into memory if possible or otherwise read in
+ * 	one go, like for pipes.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param path The path to the file to parse.
+ * @return The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if the file cannot be read or a bracket is unmatched.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_file(BrainfuckArena *arena, const char *path) {
+	BrainfuckInstruction *root;
+	int begin = 0;
+	FILE *stream;
+	char *source;
+	size_t length;
+#ifdef BRAINFUCK_PARSE_MMAP
+	struct stat status;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0 &&
+			status.st_size < INT_MAX) {
+		length = (size_t) status.st_size;
+		source = (char *) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (source != MAP_FAILED) {
+			close(fd);
+			root = brainfuck_arena_parse_substring(arena, source, &begin, (int) length);
+			munmap(source, length);
 			return root;
-		case BRAINFUCK_TOKEN_BREAK:
-			break;
-		default:
-			continue;
 		}
-		instruction->next = (BrainfuckInstruction *) malloc(sizeof(BrainfuckInstruction));
-		instruction->next->next = 0;
-		instruction->next->loop = 0;
-		instruction = instruction->next;
 	}
-	instruction->type = BRAINFUCK_TOKEN_LOOP_END;
+	if ((stream = fdopen(fd, "rb")) == NULL) {
+		close(fd);
+		return NULL;
+	}
+#else
+	if ((stream = fopen(path, "rb")) == NULL)
+		return NULL;
+#endif
+	source = brainfuck_read_stream(stream, &length);
+	fclose(stream);
+	root = brainfuck_arena_parse_substring(arena, source, &begin, (int) length);
+	free(source);
 	return root;
 }
 
@@ -276,12 +669,28 @@ BrainfuckInstruction * brainfuck_parse_stream_until(FILE *stream, const int unti
  *	and will then return a linked list containing all instructions.
  *
  * @param str The string to read from.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_string(char *str) {
 	return brainfuck_parse_substring(str, 0, -1);
 }
 
+/**
+ * Reads a character, converts it to an instruction and repeats until the string ends
+ *	and will then return a linked list containing all instructions.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param str The string to read from.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched, which is then stored in the
+ * 	arena.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_string(BrainfuckArena *arena, char *str) {
+	int begin = 0;
+	return brainfuck_arena_parse_substring(arena, str, &begin, -1);
+}
+
 /**
  * Reads a character, converts it to an instruction and repeats until the string ends
  *	and will then return a linked list containing all instructions.
@@ -290,7 +699,8 @@ BrainfuckInstruction * brainfuck_parse_string(char *str) {
  * @param begin The index you want to start parsing at.
  * @param end The index you want to stop parsing at.
  *	When <code>-1</code> is given, it will stop at the end of the string.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_substring(char *str, int begin, int end) {
 	int tmp = begin;
@@ -306,75 +716,120 @@ BrainfuckInstruction * brainfuck_parse_substring(char *str, int begin, int end)
  *	Since this will be used as counter, the value of the pointer will be increased.
  * @param end The index you want to stop parsing at.
  *	When <code>-1</code> is given, it will stop at the end of the string.
- * @param The head of the linked list containing the instructions.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched.
  */
 BrainfuckInstruction * brainfuck_parse_substring_incremental(char *str, int *ptr, int end) {
+	return brainfuck_arena_parse_substring(NULL, str, ptr, end);
+}
+
+/**
+ * Reads a character, converts it to an instruction and repeats until the string ends
+ *	and will then return a linked list containing all instructions.
+ * This method uses the begin index as counter, so this variable will increase.
+ *
+ * @param arena The arena to allocate the instructions from, or <code>NULL</code>.
+ * @param str The string to read from.
+ * @param ptr The pointer to the integer holding the index you want to start parsing at.
+ *	Since this will be used as counter, the value of the pointer will be increased.
+ * @param end The index you want to stop parsing at.
+ *	When <code>-1</code> is given, it will stop at the end of the string.
+ * @param The head of the linked list containing the instructions or
+ * 	<code>NULL</code> if a bracket is unmatched, which is then stored in the
+ * 	arena.
+ */
+BrainfuckInstruction * brainfuck_arena_parse_substring(BrainfuckArena *arena, char *str, int *ptr, int end) {
 	if (str == NULL || ptr == NULL)
 		return NULL;
 	if (end < 0)
 		end = strlen(str);
-	BrainfuckInstruction *root = (BrainfuckInstruction *) malloc(sizeof(BrainfuckInstruction));
+	if (arena != NULL)
+		arena->unmatched = 0;
+	BrainfuckInstruction *root = brainfuck_arena_instruction(arena, BRAINFUCK_TOKEN_LOOP_END, 1);
 	BrainfuckInstruction *instruction = root;
-	instruction->next = 0;
-	instruction->previous = 0;
-	instruction->loop = 0;
+	/* The loops whose closing bracket has not been found yet */
+	BrainfuckBracket *brackets = NULL;
+	size_t depth = 0, capacity = 0;
+	int begin = *ptr;
+	/* Positions are counted from where parsing starts, like in parse errors */
+	BrainfuckLines lines = { 0, 1, 0 };
 	char c, temp_c;
-	for (; *ptr < end && (c = str[*ptr]); (*ptr)++) {
+	lines.scanned = lines.start = begin;
+	/* The end is known, so null characters are skipped like other comments */
+	for (; *ptr < end; (*ptr)++) {
+			c = str[*ptr];
 			instruction->type = c;
 			instruction->difference = 1;
 			switch(c) {
 			case BRAINFUCK_TOKEN_PLUS:
 			case BRAINFUCK_TOKEN_MINUS:
-				(*ptr)++;
-				for (; *ptr < end && (temp_c = str[*ptr]) && 
-						(temp_c == BRAINFUCK_TOKEN_PLUS || temp_c == BRAINFUCK_TOKEN_MINUS); (*ptr)++) {
-					if (temp_c == c) {
-						instruction->difference++;
-					} else {
-						instruction->difference--;
-					}
-				}
-				(*ptr)--;
-				break;
 			case BRAINFUCK_TOKEN_NEXT:
 			case BRAINFUCK_TOKEN_PREVIOUS:
-				(*ptr)++;
-				for (; *ptr < end && (temp_c = str[*ptr]) && 
-						(temp_c == BRAINFUCK_TOKEN_NEXT || temp_c == BRAINFUCK_TOKEN_PREVIOUS); (*ptr)++) {
-					if (temp_c == c) {
+				brainfuck_parse_position(str, *ptr, &lines, instruction);
+				/* Runs continue across comments, so they end at the next other command */
+				for ((*ptr)++; *ptr < end; (*ptr)++) {
+					temp_c = str[*ptr];
+					if (temp_c == c)
 						instruction->difference++;
-					} else {
+					else if (temp_c == brainfuck_opposite(c))
 						instruction->difference--;
-					}
+					else if (brainfuck_is_command(temp_c))
+						break;
 				}
 				(*ptr)--;
 				break;
 			case BRAINFUCK_TOKEN_OUTPUT:
 			case BRAINFUCK_TOKEN_INPUT:
-				(*ptr)++;
-				for (; *ptr < end && (str[*ptr] == c); (*ptr)++) {
-					instruction->difference++;
+				brainfuck_parse_position(str, *ptr, &lines, instruction);
+				for ((*ptr)++; *ptr < end; (*ptr)++) {
+					temp_c = str[*ptr];
+					if (temp_c == c)
+						instruction->difference++;
+					else if (brainfuck_is_command(temp_c))
+						break;
 				}
 				(*ptr)--;
 				break;
 			case BRAINFUCK_TOKEN_LOOP_START:
-				(*ptr)++;
-				instruction->loop = brainfuck_parse_substring_incremental(str, ptr, end);
-				break;
+				brainfuck_parse_position(str, *ptr, &lines, instruction);
+				if (depth == capacity) {
+					capacity = capacity ? capacity * 2 : 16;
+					brackets = (BrainfuckBracket *) realloc(brackets, capacity * sizeof(BrainfuckBracket));
+				}
+				brackets[depth].loop = instruction;
+				brackets[depth++].position = *ptr;
+				instruction->loop = brainfuck_arena_instruction(arena, BRAINFUCK_TOKEN_LOOP_END, 1);
+				instruction = instruction->loop;
+				continue;
 			case BRAINFUCK_TOKEN_LOOP_END:
-				return root;
+				brainfuck_parse_position(str, *ptr, &lines, instruction);
+				if (depth == 0) {
+					brainfuck_parse_error(arena, str, begin, *ptr, c);
+					free(brackets);
+					brainfuck_destroy_instructions(root);
+					return NULL;
+				}
+				/* The current instruction terminates the body, parsing continues after the loop */
+				instruction = brackets[--depth].loop;
+				break;
 			case BRAINFUCK_TOKEN_BREAK:
+				brainfuck_parse_position(str, *ptr, &lines, instruction);
 				break;
 			default:
 				continue;
 			}
-			instruction->next = (BrainfuckInstruction *) malloc(sizeof(BrainfuckInstruction));
-			instruction->next->next = 0;
-			instruction->next->loop = 0;
+			instruction->next = brainfuck_arena_instruction(arena, BRAINFUCK_TOKEN_LOOP_END, 1);
 			instruction->next->previous = instruction;
 			instruction = instruction->next;
 		}
 		instruction->type = BRAINFUCK_TOKEN_LOOP_END;
+		if (depth > 0) {
+			brainfuck_parse_error(arena, str, begin, brackets[depth - 1].position, BRAINFUCK_TOKEN_LOOP_START);
+			free(brackets);
+			brainfuck_destroy_instructions(root);
+			return NULL;
+		}
+		free(brackets);
 		return root;
 }
 
@@ -385,10 +840,6 @@ BrainfuckInstruction * brainfuck_parse_substring_incremental(char *str, int *ptr
  * @param The character that's converted into an instruction.
  */
 BrainfuckInstruction * brainfuck_parse_character(char c) {
-	BrainfuckInstruction *instruction = (BrainfuckInstruction *) malloc(sizeof(BrainfuckInstruction));
-	instruction->next = 0;
-	instruction->loop = 0;
-	instruction->difference = 1;
 	switch(c) {
 	case BRAINFUCK_TOKEN_PLUS:
 	case BRAINFUCK_TOKEN_MINUS:
@@ -403,8 +854,485 @@ BrainfuckInstruction * brainfuck_parse_character(char c) {
 	default:
 		return NULL;
 	}
-	instruction->type = c;
-	return instruction;
+	return brainfuck_instruction(c, 1);
+}
+
+/**
+ * Appends an operation to the given program, growing the array of operations
+ * 	when needed.
+ *
+ * @param program The program to append the operation to.
+ * @param code The opcode of the operation.
+ * @param argument The operand of the operation.
+ * @param offset The position of the cell the operation operates on relative
+ * 	to the pointer.
+ * @return The index of the appended operation.
+ */
+static size_t brainfuck_emit(BrainfuckProgram *program, unsigned char code, int argument, int offset) {
+	if (program->length == program->capacity) {
+		program->capacity = program->capacity ? program->capacity * 2 : 64;
+		program->ops = (BrainfuckOp *) realloc(program->ops, 
+				program->capacity * sizeof(BrainfuckOp));
+		program->positions = (BrainfuckPosition *) realloc(program->positions,
+				program->capacity * sizeof(BrainfuckPosition));
+	}
+	program->ops[program->length].code = code;
+	program->ops[program->length].argument = argument;
+	program->ops[program->length].offset = offset;
+	return program->length++;
+}
+
+/**
+ * The range of cells the pointer is moved to by an iteration of a loop, which
+ * 	is determined before the loop is compiled.
+ */
+typedef struct BrainfuckWindow {
+	/* Whether every iteration returns the pointer to where the iteration started */
+	int balanced;
+	/* The amount of moves in the body that are not part of a nested loop */
+	int moves;
+	/* The lowest and highest position these moves take the pointer to */
+	long low;
+	long high;
+} BrainfuckWindow;
+
+/**
+ * A loop that is being analyzed.
+ */
+typedef struct BrainfuckWindowFrame {
+	/* The index of the window of the loop */
+	size_t window;
+	/* The position of the pointer relative to the start of the iteration */
+	long offset;
+	/* The instruction to continue with after the loop */
+	BrainfuckInstruction *next;
+	/* Whether the loop is a branch, which runs at most once */
+	char branch;
+} BrainfuckWindowFrame;
+
+/**
+ * Determines the window of every loop in the given instructions. Nested loops
+ * 	leave the pointer where they found it only if they are balanced themselves,
+ * 	and scans move it by an unknown amount, so both make a loop unbalanced.
+ * 	Branches get a window as well, but since they do not repeat, the window
+ * 	of a balanced branch is also part of the window of the enclosing loop.
+ *
+ * @param root The start of the linked list of instructions to analyze.
+ * @return The windows of the loops in the order in which the loops start.
+ */
+static BrainfuckWindow * brainfuck_analyze_windows(BrainfuckInstruction *root) {
+	BrainfuckInstruction *instruction = root;
+	BrainfuckWindow *windows = NULL, *window, *parent;
+	BrainfuckWindowFrame *frames = NULL, *frame;
+	size_t count = 0, capacity = 0, depth = 0, size = 0;
+	long offset;
+	int balanced;
+
+	while (1) {
+		if (instruction == NULL || instruction->type == BRAINFUCK_TOKEN_LOOP_END) {
+			if (depth == 0)
+				break;
+			frame = &frames[--depth];
+			window = &windows[frame->window];
+			window->balanced &= frame->offset == 0;
+			balanced = window->balanced;
+			instruction = frame->next;
+			if (depth == 0)
+				continue;
+			parent = &windows[frames[depth - 1].window];
+			if (!balanced) {
+				parent->balanced = 0;
+			} else if (frame->branch) {
+				offset = frames[depth - 1].offset;
+				parent->moves += window->moves;
+				if (offset + window->low < parent->low)
+					parent->low = offset + window->low;
+				if (offset + window->high > parent->high)
+					parent->high = offset + window->high;
+			}
+			continue;
+		}
+		frame = depth > 0 ? &frames[depth - 1] : NULL;
+		switch (instruction->type) {
+		case BRAINFUCK_TOKEN_NEXT:
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			if (frame == NULL)
+				break;
+			window = &windows[frame->window];
+			frame->offset += instruction->type == BRAINFUCK_TOKEN_NEXT ?
+				instruction->difference : -instruction->difference;
+			window->moves++;
+			if (frame->offset < window->low)
+				window->low = frame->offset;
+			if (frame->offset > window->high)
+				window->high = frame->offset;
+			break;
+		case BRAINFUCK_TOKEN_SCAN:
+			if (frame != NULL)
+				windows[frame->window].balanced = 0;
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+			if (count == capacity) {
+				capacity = capacity ? capacity * 2 : 16;
+				windows = (BrainfuckWindow *) realloc(windows, capacity * sizeof(BrainfuckWindow));
+			}
+			if (depth == size) {
+				size = size ? size * 2 : 16;
+				frames = (BrainfuckWindowFrame *) realloc(frames, size * sizeof(BrainfuckWindowFrame));
+			}
+			windows[count].balanced = 1;
+			windows[count].moves = 0;
+			windows[count].low = 0;
+			windows[count].high = 0;
+			frames[depth].window = count++;
+			frames[depth].offset = 0;
+			frames[depth].branch = instruction->type == BRAINFUCK_TOKEN_IF;
+			frames[depth++].next = instruction->next;
+			instruction = instruction->loop;
+			continue;
+		default:
+			if (instruction->type == BRAINFUCK_TOKEN_PLUS || instruction->type == BRAINFUCK_TOKEN_MINUS ||
+					instruction->type == BRAINFUCK_TOKEN_OUTPUT || instruction->type == BRAINFUCK_TOKEN_INPUT ||
+					instruction->type == BRAINFUCK_TOKEN_BREAK || instruction->type == BRAINFUCK_TOKEN_SET ||
+					instruction->type == BRAINFUCK_TOKEN_MULTIPLY || instruction->type == BRAINFUCK_TOKEN_COUNT)
+				break;
+			/* Unknown instructions end the list, as they do in brainfuck_compile */
+			instruction = NULL;
+			continue;
+		}
+		instruction = instruction->next;
+	}
+	free(frames);
+	return windows;
+}
+
+/* The amount of cells scans try one by one before using the scan kernels */
+#define BRAINFUCK_SCAN_PROBES 4
+/* Profiled scans that move fewer strides than this are not worth a kernel call */
+#define BRAINFUCK_SCAN_SHORT 16
+
+/**
+ * Determines the amount of cells a scan tries one by one before using the
+ * 	scan kernels, which is a few by default, so short scans avoid the call.
+ * 	Scans that are profiled to be short are probed all the way, while scans
+ * 	that are profiled to be long go to the kernels right away.
+ *
+ * @param instruction The scan instruction.
+ * @return The amount of cells to probe.
+ */
+static int brainfuck_compile_probes(BrainfuckInstruction *instruction) {
+	if (instruction->offset <= 0)
+		return BRAINFUCK_SCAN_PROBES;
+	return instruction->offset - 1 < BRAINFUCK_SCAN_SHORT ? BRAINFUCK_SCAN_SHORT : 0;
+}
+
+/**
+ * The pointer movement that is delayed until the end of a stretch of code
+ * 	without control flow, so that the operations in between can address
+ * 	their cells relative to where the pointer was left.
+ */
+typedef struct BrainfuckBlock {
+	/* The distance the pointer has moved since it was last updated */
+	long pending;
+	/* Whether the cells the block accesses are checked by a range check */
+	int checked;
+	/* The index of that range check */
+	size_t check;
+	/* The distance the operations emitted so far move the pointer */
+	long moved;
+} BrainfuckBlock;
+
+/**
+ * A loop or branch that is being compiled.
+ */
+typedef struct BrainfuckCompileFrame {
+	/* The instruction to continue with after the loop */
+	BrainfuckInstruction *next;
+	/* The index of the operation that starts the loop */
+	size_t start;
+	/* Whether the moves in the loop are checked on entry of the loop */
+	char hoisted;
+	/* Whether the loop is a branch, which is not jumped back to */
+	char branch;
+	/* Whether the pointer movement is folded across the branch */
+	char folded;
+	/* The block the branch interrupts, which continues after the branch */
+	BrainfuckBlock block;
+} BrainfuckCompileFrame;
+
+/**
+ * Extends the range check of the given block to the cell the pointer has
+ * 	moved to.
+ */
+static void brainfuck_compile_widen(BrainfuckProgram *program, BrainfuckBlock *block) {
+	BrainfuckOp *check = &program->ops[block->check];
+	if (block->pending > check->argument)
+		check->argument = (int) block->pending;
+	if (block->pending < check->offset)
+		check->offset = (int) block->pending;
+}
+
+/**
+ * Appends an operation on the cell the pointer has moved to in the given
+ * 	block. Outside of loops that are checked on entry, the first access away
+ * 	from the pointer opens a range check that is widened by every later
+ * 	access of the block.
+ *
+ * @param program The program to append the operation to.
+ * @param block The block the operation is part of.
+ * @param hoisted Whether the moves are checked on entry of the enclosing loop.
+ * @param code The opcode of the operation.
+ * @param argument The operand of the operation.
+ * @return The index of the appended operation.
+ */
+static size_t brainfuck_compile_access(BrainfuckProgram *program, BrainfuckBlock *block, int hoisted,
+		unsigned char code, int argument) {
+	if (block->pending != 0 && !hoisted) {
+		if (!block->checked) {
+			block->check = brainfuck_emit(program, BRAINFUCK_OP_CHECK, 0, 0);
+			block->checked = 1;
+		}
+		brainfuck_compile_widen(program, block);
+	}
+	return brainfuck_emit(program, code, argument, (int) block->pending);
+}
+
+/**
+ * Appends the delayed pointer movement of the given block, which is left
+ * 	unchecked when it is covered by the range check of the block or the check
+ * 	on entry of the enclosing loop.
+ *
+ * @param program The program to append the movement to.
+ * @param block The block to end.
+ * @param hoisted Whether the moves are checked on entry of the enclosing loop.
+ * @param strict Whether the movement has to be checked by itself, because
+ * 	the cell it moves to is not accessed before the next block.
+ */
+static void brainfuck_compile_flush(BrainfuckProgram *program, BrainfuckBlock *block, int hoisted,
+		int strict) {
+	if (block->pending != 0) {
+		if (block->checked && !strict)
+			brainfuck_compile_widen(program, block);
+		if (hoisted || (block->checked && !strict))
+			brainfuck_emit(program, BRAINFUCK_OP_MOVE, (int) block->pending, 0);
+		else if (block->pending > 0)
+			brainfuck_emit(program, BRAINFUCK_OP_RIGHT, (int) block->pending, 0);
+		else
+			brainfuck_emit(program, BRAINFUCK_OP_LEFT, (int) -block->pending, 0);
+	}
+	block->moved += block->pending;
+	block->pending = 0;
+	block->checked = 0;
+}
+
+/**
+ * Compiles the given linked list of instructions into a program that stores its
+ * 	operations in contiguous memory and can be executed using
+ * 	<code>brainfuck_execute_program</code>.
+ *
+ * The tree is walked without recursion, so the nesting depth of the loops is
+ * 	only limited by the available memory.
+ * Loops that return the pointer to where each iteration started check once on
+ * 	entry that the cells their body moves to lie on the tape, after which the
+ * 	moves in the body are not checked anymore.
+ * Moves are not compiled into operations of their own, but folded into the
+ * 	offsets of the operations that follow them until the next loop, scan,
+ * 	multiplication or breakpoint, where the pointer is updated at once.
+ * 	Outside of checked loops a single range check at the start of such a
+ * 	block covers all of its accesses, so a block can report running off the
+ * 	tape before its other effects have happened.
+ * Branches do not jump back, so the pointer movement is folded across the
+ * 	branches that leave the pointer where they found it.
+ * Scans try a few cells one by one before calling the scan kernels, unless
+ * 	an applied profile shows them to be short or long.
+ *
+ * @param root The start of the linked list of instructions to compile.
+ * @return The compiled program.
+ */
+BrainfuckProgram * brainfuck_compile(BrainfuckInstruction *root) {
+	BrainfuckProgram *program = (BrainfuckProgram *) malloc(sizeof(BrainfuckProgram));
+	BrainfuckInstruction *instruction = root;
+	/* The open loops and branches */
+	BrainfuckCompileFrame *frames = NULL, *frame;
+	BrainfuckWindow *windows = brainfuck_analyze_windows(root), *window;
+	BrainfuckBlock block = { 0, 0, 0, 0 };
+	BrainfuckPosition position = { 0, 0 };
+	size_t depth = 0, size = 0, loops = 0, end, positioned = 0;
+	int move, covered;
+
+	program->ops = NULL;
+	program->length = 0;
+	program->capacity = 0;
+	program->positions = NULL;
+	program->counts = NULL;
+	program->steps = NULL;
+
+	while (1) {
+		/* The operations emitted since the previous instruction are compiled from it */
+		for (; positioned < program->length; positioned++)
+			program->positions[positioned] = position;
+		/* The end of the program has no position, so what it emits belongs to the last instruction */
+		if (instruction != NULL && (instruction->type != BRAINFUCK_TOKEN_LOOP_END || depth > 0))
+			position = instruction->position;
+		covered = depth > 0 && frames[depth - 1].hoisted;
+		if (instruction == NULL || instruction->type == BRAINFUCK_TOKEN_LOOP_END) {
+			if (depth == 0)
+				break;
+			frame = &frames[--depth];
+			instruction = frame->next;
+			if (frame->branch) {
+				if (frame->folded) {
+					/* Either way the pointer ends up where the branch found it */
+					if (block.moved != frame->block.moved)
+						brainfuck_emit(program, BRAINFUCK_OP_MOVE, (int) (frame->block.moved - block.moved), 0);
+					block = frame->block;
+				} else {
+					brainfuck_compile_flush(program, &block, covered, 0);
+				}
+				program->ops[frame->start].argument = (int) (program->length - 1 - frame->start);
+				continue;
+			}
+			brainfuck_compile_flush(program, &block, covered, 0);
+			end = brainfuck_emit(program, BRAINFUCK_OP_LOOP_END, 0, 0);
+			program->ops[frame->start].argument = (int) (end - frame->start);
+			/* Jumping back skips the check on entry */
+			program->ops[end].argument = (int) (frame->start + frame->hoisted) - (int) end;
+			continue;
+		}
+		switch (instruction->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+		case BRAINFUCK_TOKEN_MINUS:
+			if (instruction->difference != 0)
+				brainfuck_compile_access(program, &block, covered, BRAINFUCK_OP_ADD,
+					instruction->type == BRAINFUCK_TOKEN_PLUS ?
+					instruction->difference : -instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			move = instruction->type == BRAINFUCK_TOKEN_NEXT ?
+				instruction->difference : -instruction->difference;
+			/* Offsets have to fit in the operations */
+			if (block.pending + move > INT_MAX || block.pending + move < INT_MIN)
+				brainfuck_compile_flush(program, &block, covered, 0);
+			block.pending += move;
+			break;
+		case BRAINFUCK_TOKEN_OUTPUT:
+			if (instruction->difference > 0)
+				brainfuck_compile_access(program, &block, covered, BRAINFUCK_OP_OUTPUT,
+					instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_INPUT:
+			if (instruction->difference > 0)
+				brainfuck_compile_access(program, &block, covered, BRAINFUCK_OP_INPUT,
+					instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+			if (depth == size) {
+				size = size ? size * 2 : 16;
+				frames = (BrainfuckCompileFrame *) realloc(frames, size * sizeof(BrainfuckCompileFrame));
+			}
+			window = &windows[loops++];
+			frame = &frames[depth++];
+			frame->next = instruction->next;
+			frame->branch = instruction->type == BRAINFUCK_TOKEN_IF;
+			if (frame->branch) {
+				/* The window of the branch is part of the window of the enclosing loop */
+				frame->hoisted = (char) covered;
+				frame->folded = window->balanced && block.pending + window->low > INT_MIN &&
+					block.pending + window->high < INT_MAX;
+				if (!frame->folded)
+					brainfuck_compile_flush(program, &block, covered, 0);
+				frame->start = brainfuck_compile_access(program, &block, covered, BRAINFUCK_OP_IF, 0);
+				frame->block = block;
+				/* The body does not always run, so its accesses are checked by the body */
+				block.checked = 0;
+			} else {
+				brainfuck_compile_flush(program, &block, covered, 0);
+				frame->start = brainfuck_emit(program, BRAINFUCK_OP_LOOP_START, 0, 0);
+				frame->hoisted = window->balanced && window->moves > 0 &&
+					window->low > INT_MIN && window->high < INT_MAX;
+				if (frame->hoisted)
+					brainfuck_emit(program, BRAINFUCK_OP_CHECK, (int) window->high, (int) window->low);
+			}
+			instruction = instruction->loop;
+			continue;
+		case BRAINFUCK_TOKEN_BREAK:
+			/* The breakpoint does not access the tape, so it cannot rely on the guard regions */
+			brainfuck_compile_flush(program, &block, covered, 1);
+			brainfuck_emit(program, BRAINFUCK_OP_BREAK, 0, 0);
+			break;
+		case BRAINFUCK_TOKEN_SET:
+			brainfuck_compile_access(program, &block, covered, BRAINFUCK_OP_SET,
+				instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_SCAN:
+			brainfuck_compile_flush(program, &block, covered, 0);
+			if (instruction->difference > 0)
+				brainfuck_emit(program, BRAINFUCK_OP_SCAN_RIGHT, instruction->difference,
+					brainfuck_compile_probes(instruction));
+			else
+				brainfuck_emit(program, BRAINFUCK_OP_SCAN_LEFT, -instruction->difference,
+					brainfuck_compile_probes(instruction));
+			break;
+		case BRAINFUCK_TOKEN_MULTIPLY:
+			/* The offset of the operation is taken by its target */
+			brainfuck_compile_flush(program, &block, covered, 0);
+			brainfuck_emit(program, BRAINFUCK_OP_MULTIPLY, instruction->difference, instruction->offset);
+			break;
+		case BRAINFUCK_TOKEN_COUNT:
+			/* The multiplications that follow need the pointer to be up to date */
+			brainfuck_compile_flush(program, &block, covered, 0);
+			brainfuck_emit(program, BRAINFUCK_OP_COUNT, instruction->difference, 0);
+			break;
+		default:
+			/* Unknown instructions end the list, as they do in brainfuck_execute */
+			instruction = NULL;
+			continue;
+		}
+		instruction = instruction->next;
+	}
+	brainfuck_compile_flush(program, &block, 0, 0);
+	brainfuck_emit(program, BRAINFUCK_OP_END, 0, 0);
+	for (; positioned < program->length; positioned++)
+		program->positions[positioned] = position;
+	free(frames);
+	free(windows);
+	return program;
+}
+
+/**
+ * Writes a listing of the operations of the given program to the given stream,
+ * 	followed by the amount of moves that are checked, the amount of moves
+ * 	that are not and the amount of range checks that cover the latter.
+ *
+ * @param program The program to list.
+ * @param stream The stream to write the listing to.
+ */
+void brainfuck_dump_program(BrainfuckProgram *program, FILE *stream) {
+	static const char *names[] = {
+		"end", "add", "right", "left", "output", "input", "loop_start", "loop_end",
+		"break", "set", "scan_right", "scan_left", "multiply", "move", "check", "count", "if"
+	};
+	size_t checked = 0, unchecked = 0, checks = 0, i;
+	BrainfuckOp *op;
+
+	for (i = 0; i < program->length; i++) {
+		op = &program->ops[i];
+		if (op->code == BRAINFUCK_OP_RIGHT || op->code == BRAINFUCK_OP_LEFT)
+			checked++;
+		else if (op->code == BRAINFUCK_OP_MOVE)
+			unchecked++;
+		else if (op->code == BRAINFUCK_OP_CHECK)
+			checks++;
+		if (op->code < sizeof(names) / sizeof(names[0]))
+			fprintf(stream, "%6zu  %-10s %d %d\n", i, names[op->code], op->argument, op->offset);
+		else
+			fprintf(stream, "%6zu  %-10d %d %d\n", i, op->code, op->argument, op->offset);
+	}
+	fprintf(stream, "%zu checked moves, %zu unchecked moves, %zu range checks\n",
+		checked, unchecked, checks);
 }
 
 /**
@@ -413,7 +1341,8 @@ BrainfuckInstruction * brainfuck_parse_character(char c) {
  * @param instruction The instruction to destroy.
  */
 void brainfuck_destroy_instruction(BrainfuckInstruction *instruction) {
-	if (instruction == NULL)
+	/* Instructions allocated from an arena are freed together with the arena */
+	if (instruction == NULL || instruction->pooled)
 		return;
 	free(instruction);
 	instruction = 0;
@@ -427,13 +1356,36 @@ void brainfuck_destroy_instruction(BrainfuckInstruction *instruction) {
 void brainfuck_destroy_instructions(BrainfuckInstruction *root) {
 	BrainfuckInstruction *tmp;
 	while (root != NULL) {
+		/* Loop bodies are spliced into the list, so nesting needs no recursion */
+		if (root->loop != NULL) {
+			for (tmp = root->loop; tmp->next != NULL; tmp = tmp->next);
+			tmp->next = root->next;
+			root->next = root->loop;
+			root->loop = NULL;
+		}
 		tmp = root;
-		brainfuck_destroy_instructions(root->loop);
 		root = root->next;
 		brainfuck_destroy_instruction(tmp);
 	}
 }
 
+/**
+ * Destroys an arena and all instructions that are allocated from it.
+ *
+ * @param arena The arena to destroy.
+ */
+void brainfuck_destroy_arena(BrainfuckArena *arena) {
+	BrainfuckArenaBlock *block;
+	if (arena == NULL)
+		return;
+	while (arena->block != NULL) {
+		block = arena->block;
+		arena->block = block->previous;
+		free(block);
+	}
+	free(arena);
+}
+
 /**
  * Destroys a state.
  * 
@@ -442,7 +1394,10 @@ void brainfuck_destroy_instructions(BrainfuckInstruction *root) {
 void brainfuck_destroy_state(BrainfuckState *state) {
 	if (state == NULL)
 		return;
-	brainfuck_destroy_instructions(state->root);
+	/* Only instructions that were not allocated from the arena need to be visited */
+	if (state->unpooled)
+		brainfuck_destroy_instructions(state->root);
+	brainfuck_destroy_arena(state->arena);
 	state->head = 0;
 	state->root = 0;
 	free(state);
@@ -455,107 +1410,293 @@ void brainfuck_destroy_state(BrainfuckState *state) {
  * @param context The context to destroy
  */
 void brainfuck_destroy_context(BrainfuckExecutionContext *context) {
-	free(context->tape);
+	brainfuck_flush(context);
+	free(context->output);
+	free(context->input);
+	if (context->guarded)
+		brainfuck_tape_unguard(context);
+	else
+		free(context->tape);
 	free(context);
 	context = 0;
 }
 
+/**
+ * Returns the value of the cell at the given index of the tape of the given context.
+ */
+static unsigned long brainfuck_cell(BrainfuckExecutionContext *context, int index) {
+	switch (context->cell_width) {
+	case 16:
+		return ((uint16_t *) context->tape)[index];
+	case 32:
+		return ((uint32_t *) context->tape)[index];
+	default:
+		return context->tape[index];
+	}
+}
+
+/**
+ * Prints the cells surrounding the current cell of the given context.
+ *
+ * @param context The context of which the tape should be printed.
+ */
+static void brainfuck_print_tape(BrainfuckExecutionContext *context) {
+	int index;
+	int low  = context->tape_index - 10;
+	brainfuck_flush(context);
+	if (low < 0) low = 0;
+	int high = low + 21;
+	if (high >= (int) context->tape_size) 
+		high = context->tape_size-1;
+	for (index = low; index < high; index++)
+		printf("%i\t", index);
+	printf("\n");
+	for (index = low; index < high; index++)
+		printf("%lu\t", brainfuck_cell(context, index));
+	printf("\n");
+	for (index = low; index < high; index++)
+		if (index == context->tape_index)
+			printf("^\t");
+	else
+		printf(" \t");
+	printf("\n");
+}
+
+/**
+ * Destroys a compiled program.
+ *
+ * @param program The program to destroy.
+ */
+void brainfuck_destroy_program(BrainfuckProgram *program) {
+	if (program == NULL)
+		return;
+	free(program->ops);
+	free(program->positions);
+	free(program->counts);
+	free(program->steps);
+	free(program);
+}
+
+/*
+ * The compiled program executor is written in terms of the macros below, so
+ * 	that it can either be compiled as threaded code, where every operation
+ * 	jumps directly to the handler of the next operation using the labels as
+ * 	values extension of GCC and Clang, or as a portable switch statement.
+ */
+#if defined(BRAINFUCK_THREADED_CODE) && defined(__GNUC__) && !defined(__STRICT_ANSI__)
+#	define BRAINFUCK_DISPATCH_THREADED
+#	define BRAINFUCK_OP(code) op_##code:
+#	define BRAINFUCK_DISPATCH() goto *dispatch[op->code]
+#else
+#	define BRAINFUCK_OP(code) case code:
+#	define BRAINFUCK_DISPATCH() continue
+#endif
+
+/* Advances to the next operation, of which only loops check whether to stop */
+#define BRAINFUCK_NEXT() \
+	op++; \
+	BRAINFUCK_PROFILE_OP(); \
+	BRAINFUCK_DISPATCH()
+
+/*
+ * Reads and sets the flag that stops execution, atomically where the compiler
+ * 	supports it, so that other threads can set it too. Otherwise the flag is
+ * 	only safe to set from a signal handler on the thread that runs the
+ * 	program. The flag carries no other data, so no ordering is needed.
+ */
+#ifdef __ATOMIC_RELAXED
+#	define BRAINFUCK_LOAD_STOP(context) __atomic_load_n(&(context)->shouldStop, __ATOMIC_RELAXED)
+#	define BRAINFUCK_STORE_STOP(context, value) \
+	__atomic_store_n(&(context)->shouldStop, (value), __ATOMIC_RELAXED)
+#else
+#	define BRAINFUCK_LOAD_STOP(context) ((context)->shouldStop)
+#	define BRAINFUCK_STORE_STOP(context, value) ((context)->shouldStop = (value))
+#endif
+
+/*
+ * Checks on a back-edge of a loop whether execution is stopped and takes the
+ * 	given cost from the budget, refilling it when it is used up, in which
+ * 	case the fuel and the deadline are checked. Both executors keep the budget
+ * 	in a local variable and continue at the given label with the status set
+ * 	if execution has to end.
+ */
+#define BRAINFUCK_BACK_EDGE(cost, label) \
+	if (BRAINFUCK_LOAD_STOP(context) == 1) { \
+		status = BRAINFUCK_STATUS_STOPPED; \
+		goto label; \
+	} \
+	if ((budget -= (cost)) < 0) { \
+		context->budget = budget; \
+		status = brainfuck_budget_refill(context); \
+		budget = context->budget; \
+		if (status != BRAINFUCK_STATUS_OK) \
+			goto label; \
+	}
+
+/*
+ * The executors are instantiated from execute.h once for every cell width, so
+ * 	that the width of the cells is known at compile time and no operation has
+ * 	to branch on it. The public executors only select the instantiation.
+ */
+#ifdef __GNUC__
+/* Inlining all instantiations into the public executors pessimizes the hot loops */
+#	define BRAINFUCK_NOINLINE __attribute__((noinline))
+#else
+#	define BRAINFUCK_NOINLINE
+#endif
+
+#define BRAINFUCK_CELL unsigned char
+#define BRAINFUCK_CELL_NAME(name) name##_8
+#define BRAINFUCK_SCAN_RIGHT brainfuck_scan_right
+#define BRAINFUCK_SCAN_LEFT brainfuck_scan_left
+#include "execute.h"
+
+#define BRAINFUCK_CELL uint16_t
+#define BRAINFUCK_CELL_NAME(name) name##_16
+#define BRAINFUCK_SCAN_RIGHT brainfuck_scan_right_16
+#define BRAINFUCK_SCAN_LEFT brainfuck_scan_left_16
+#include "execute.h"
+
+#define BRAINFUCK_CELL uint32_t
+#define BRAINFUCK_CELL_NAME(name) name##_32
+#define BRAINFUCK_SCAN_RIGHT brainfuck_scan_right_32
+#define BRAINFUCK_SCAN_LEFT brainfuck_scan_left_32
+#include "execute.h"
+
+/* The profiled executors only exist for compiled programs */
+#define BRAINFUCK_PROFILE
+#define BRAINFUCK_CELL unsigned char
+#define BRAINFUCK_CELL_NAME(name) name##_8_profiled
+#define BRAINFUCK_SCAN_RIGHT brainfuck_scan_right
+#define BRAINFUCK_SCAN_LEFT brainfuck_scan_left
+#include "execute.h"
+
+#define BRAINFUCK_PROFILE
+#define BRAINFUCK_CELL uint16_t
+#define BRAINFUCK_CELL_NAME(name) name##_16_profiled
+#define BRAINFUCK_SCAN_RIGHT brainfuck_scan_right_16
+#define BRAINFUCK_SCAN_LEFT brainfuck_scan_left_16
+#include "execute.h"
+
+#define BRAINFUCK_PROFILE
+#define BRAINFUCK_CELL uint32_t
+#define BRAINFUCK_CELL_NAME(name) name##_32_profiled
+#define BRAINFUCK_SCAN_RIGHT brainfuck_scan_right_32
+#define BRAINFUCK_SCAN_LEFT brainfuck_scan_left_32
+#include "execute.h"
+
 /**
  * Executes the given linked list containing instructions.
+ *
+ * The loops that are being executed are kept on a stack instead of executing
+ * 	their bodies recursively, so the nesting depth of the loops is only
+ * 	limited by the available memory.
  * 
  * @param root The start of the linked list of instructions you want
  * 	to execute.
  * @param context The context of this execution that contains the tape and
  *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
  */
-void brainfuck_execute(BrainfuckInstruction *root, BrainfuckExecutionContext *context) {
+int brainfuck_execute(BrainfuckInstruction *root, BrainfuckExecutionContext *context) {
 	if (root == NULL || context == NULL)
-		return;
-	BrainfuckInstruction *instruction = root;
-	int index;
-	while (instruction != NULL && instruction->type != BRAINFUCK_TOKEN_LOOP_END) {
-		switch (instruction->type) {
-		case BRAINFUCK_TOKEN_PLUS:
-			context->tape[context->tape_index] += instruction->difference;
-			break;
-		case BRAINFUCK_TOKEN_MINUS:
-			context->tape[context->tape_index] -= instruction->difference;
-			break;
-		case BRAINFUCK_TOKEN_NEXT:
-			if (instruction->difference >= INT_MAX - (long) context->tape_size ||
-					(long) context->tape_index + instruction->difference >= (long) context->tape_size) {
-				fprintf(stderr, "error: tape memory out of bounds (overrun)\nexceeded the tape size of %zd cells\n", context->tape_size);
-				exit(EXIT_FAILURE);
-			}
-			context->tape_index += instruction->difference;
-			break;
-		case BRAINFUCK_TOKEN_PREVIOUS:
-			if (instruction->difference >= INT_MAX - (long) context->tape_size ||
-                    (long) context->tape_index - instruction->difference < 0) {
-				fprintf(stderr, "error: tape memory out of bounds (underrun)\nundershot the tape size of %zd cells\n", context->tape_size);
-				exit(EXIT_FAILURE);
-			}
-			context->tape_index -= instruction->difference;
-			break;
-		case BRAINFUCK_TOKEN_OUTPUT:
-			for (index = 0; index < instruction->difference; index++)
-				context->output_handler(context->tape[context->tape_index]);
-			break;
-		case BRAINFUCK_TOKEN_INPUT:
-			for (index = 0; index < instruction->difference; index++) {
-				char input = context->input_handler();
-				if (input == EOF) {
-					if (BRAINFUCK_EOF_BEHAVIOR != 1)
-						context->tape[context->tape_index] = BRAINFUCK_EOF_BEHAVIOR;
-				} else {
-					context->tape[context->tape_index] = input;
-				}
-			}
-			break;
-		case BRAINFUCK_TOKEN_LOOP_START:
-			while(context->tape[context->tape_index])
-				brainfuck_execute(instruction->loop, context);
-			break;
-		case BRAINFUCK_TOKEN_BREAK: {
-			int low  = context->tape_index - 10;
-			if (low < 0) low = 0;
-			int high = low + 21;
-			if (high >= (int) context->tape_size) 
-				high = context->tape_size-1;
-			for (index = low; index < high; index++)
-				printf("%i\t", index);
-			printf("\n");
-			for (index = low; index < high; index++)
-				printf("%d\t", context->tape[index]);
-			printf("\n");
-			for (index = low; index < high; index++)
-				if (index == context->tape_index)
-					printf("^\t");
-			else
-				printf(" \t");
-			printf("\n");
-			break;
-		}
-		default:
-			return;
-		}
-		instruction = instruction->next;
+		return BRAINFUCK_STATUS_OK;
+	switch (context->cell_width) {
+	case 16:
+		return brainfuck_execute_16(root, context);
+	case 32:
+		return brainfuck_execute_32(root, context);
+	default:
+		return brainfuck_execute_8(root, context);
+	}
+}
 
-		if (context->shouldStop == 1) {
-			instruction = NULL;
-			return;
-		}
+/**
+ * Executes the given compiled program.
+ *
+ * @param program The program to execute.
+ * @param context The context of this execution that contains the tape and
+ *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
+ */
+int brainfuck_execute_program(BrainfuckProgram *program, BrainfuckExecutionContext *context) {
+	BrainfuckTapeRecovery recovery;
+	int status;
+	if (program == NULL || context == NULL)
+		return BRAINFUCK_STATUS_OK;
+	/* The executors themselves do not set the recovery point, which would pessimize their hot loops */
+	BRAINFUCK_TAPE_RECOVER(context, recovery, status, end);
+	switch (context->cell_width) {
+	case 16:
+		status = brainfuck_execute_program_16(program, context);
+		break;
+	case 32:
+		status = brainfuck_execute_program_32(program, context);
+		break;
+	default:
+		status = brainfuck_execute_program_8(program, context);
+		break;
+	}
+	if (context->guarded)
+		brainfuck_tape_leave(context);
+end:
+	return status;
+}
+
+/**
+ * Executes the given compiled program while counting how often every operation
+ * 	is executed in the <code>counts</code> of the program and how far every
+ * 	scan moves in its <code>steps</code>, which are added to the counts of
+ * 	earlier runs. Programs that are not profiled run without this overhead.
+ *
+ * @param program The program to execute.
+ * @param context The context of this execution that contains the tape and
+ *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
+ */
+int brainfuck_profile_program(BrainfuckProgram *program, BrainfuckExecutionContext *context) {
+	BrainfuckTapeRecovery recovery;
+	int status;
+	if (program == NULL || context == NULL)
+		return BRAINFUCK_STATUS_OK;
+	if (program->counts == NULL)
+		program->counts = (unsigned long *) calloc(program->length, sizeof(unsigned long));
+	if (program->steps == NULL)
+		program->steps = (unsigned long *) calloc(program->length, sizeof(unsigned long));
+	BRAINFUCK_TAPE_RECOVER(context, recovery, status, end);
+	switch (context->cell_width) {
+	case 16:
+		status = brainfuck_execute_program_16_profiled(program, context);
+		break;
+	case 32:
+		status = brainfuck_execute_program_32_profiled(program, context);
+		break;
+	default:
+		status = brainfuck_execute_program_8_profiled(program, context);
+		break;
 	}
+	if (context->guarded)
+		brainfuck_tape_leave(context);
+end:
+	return status;
 }
 
 /*
  * Stops the currently running program referenced by the given execution context.
+ * 	This is safe to call from a signal handler, and from another thread when
+ * 	the library is built by a compiler with atomic builtins.
  *
  * @param context The context of this execution that contains the tape and
  *	other execution related variables.
  */
 void brainfuck_execution_stop(BrainfuckExecutionContext *context) {
-	context->shouldStop = 1;
+	BRAINFUCK_STORE_STOP(context, 1);
 }
 
 /**
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#endif
+
+#include <brainfuck.h>
+
+#include "budget.h"
+
+/* The amount of operations between two checks of the clock */
+#define BRAINFUCK_BUDGET_INTERVAL (1L << 20)
+
+/**
+ * Returns the time of a monotonic clock in milliseconds, which deadlines of
+ * 	execution contexts are expressed in.
+ *
+ * @return The current time in milliseconds since an arbitrary moment.
+ */
+long long brainfuck_clock(void) {
+#if defined(_WIN32)
+	return (long long) GetTickCount64();
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#else
+	return (long long) time(NULL) * 1000;
+#endif
+}
+
+/**
+ * Called by the executors when the budget of the given context is used up,
+ * 	which takes the operations executed beyond it from the fuel of the
+ * 	context, checks the deadline and hands out a new budget.
+ *
+ * @param context The context of which the budget is used up.
+ * @return <code>0</code> if execution can continue, otherwise
+ * 	<code>BRAINFUCK_STATUS_BUDGET</code> if the program ran out of fuel or
+ * 	time.
+ */
+int brainfuck_budget_refill(BrainfuckExecutionContext *context) {
+	long budget = BRAINFUCK_BUDGET_INTERVAL;
+	if (context->fuel >= 0) {
+		/* The budget handed out before is already taken from the fuel */
+		context->fuel += context->budget;
+		if (context->fuel <= 0) {
+			context->fuel = 0;
+			context->budget = 0;
+			return BRAINFUCK_STATUS_BUDGET;
+		}
+		if (context->fuel < budget)
+			budget = (long) context->fuel;
+		context->fuel -= budget;
+	}
+	context->budget = budget;
+	if (context->deadline > 0 && brainfuck_clock() >= context->deadline)
+		return BRAINFUCK_STATUS_BUDGET;
+	return 0;
+}
+
+/**
+ * Returns the budget of the given context that is not used up to its fuel,
+ * 	which the executors do when execution ends.
+ *
+ * @param context The context of which execution ended.
+ */
+void brainfuck_budget_settle(BrainfuckExecutionContext *context) {
+	if (context->fuel >= 0) {
+		context->fuel += context->budget;
+		if (context->fuel < 0)
+			context->fuel = 0;
+	}
+	context->budget = 0;
+}
+
+/**
+ * Limits the time the programs executed in the given context may run, which
+ * 	is checked every so many operations while loops jump back.
+ *
+ * @param context The context to limit.
+ * @param milliseconds The time the programs may run from now on, or
+ * 	<code>0</code> to remove the limit.
+ */
+void brainfuck_set_timeout(BrainfuckExecutionContext *context, long milliseconds) {
+	context->deadline = milliseconds > 0 ? brainfuck_clock() + milliseconds : 0;
+}
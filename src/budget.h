@@ -0,0 +1,49 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BRAINFUCK_BUDGET_H
+#define BRAINFUCK_BUDGET_H
+
+#include <brainfuck.h>
+
+/**
+ * Returns the time of a monotonic clock in milliseconds, which deadlines of
+ * 	execution contexts are expressed in.
+ *
+ * @return The current time in milliseconds since an arbitrary moment.
+ */
+long long brainfuck_clock(void);
+
+/**
+ * Called by the executors when the budget of the given context is used up,
+ * 	which takes the operations executed beyond it from the fuel of the
+ * 	context, checks the deadline and hands out a new budget.
+ *
+ * @param context The context of which the budget is used up.
+ * @return <code>0</code> if execution can continue, otherwise
+ * 	<code>BRAINFUCK_STATUS_BUDGET</code> if the program ran out of fuel or
+ * 	time.
+ */
+int brainfuck_budget_refill(BrainfuckExecutionContext *);
+
+/**
+ * Returns the budget of the given context that is not used up to its fuel,
+ * 	which the executors do when execution ends.
+ *
+ * @param context The context of which execution ended.
+ */
+void brainfuck_budget_settle(BrainfuckExecutionContext *);
+
+#endif /* BRAINFUCK_BUDGET_H */
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+
+#include "count.h"
+
+/**
+ * Determines how many times a loop that adds the given step to its cell runs
+ * 	before the cell becomes zero, by solving
+ * 	<code>value + n * step = 0</code> modulo <code>2^bits</code>.
+ * An odd step reaches zero from every value and is inverted modulo the cell
+ * 	size, while an even step <code>2^t * u</code> only reaches zero from
+ * 	values that are a multiple of <code>2^t</code>.
+ *
+ * @param value The value of the cell.
+ * @param step The amount the loop adds to the cell every iteration.
+ * @param bits The width of the cell in bits, which is at most 32.
+ * @return The amount of iterations, which fits in a cell, or <code>-1</code>
+ * 	if the loop never terminates.
+ */
+long brainfuck_count(unsigned long value, int step, int bits) {
+	uint64_t mask = ((uint64_t) 1 << bits) - 1;
+	uint64_t x = (uint64_t) value & mask;
+	uint64_t s = (uint64_t) (int64_t) step & mask;
+	uint64_t inverse;
+	int shift = 0, i;
+
+	if (x == 0)
+		return 0;
+	/* A step that is a multiple of the cell size never changes the cell */
+	if (s == 0)
+		return -1;
+	while (!(s & 1)) {
+		s >>= 1;
+		shift++;
+	}
+	if (x & (((uint64_t) 1 << shift) - 1))
+		return -1;
+	/* Every Newton iteration doubles the amount of correct bits, 3 are correct to start with */
+	inverse = s;
+	for (i = 0; i < 4; i++)
+		inverse *= 2 - s * inverse;
+	return (long) ((((mask + 1 - x) & mask) >> shift) * inverse & (mask >> shift));
+}
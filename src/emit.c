@@ -0,0 +1,182 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <brainfuck.h>
+
+/* The code that precedes the translated instructions */
+static const char *brainfuck_emit_prologue =
+	"#include <stdio.h>\n"
+	"#include <stdlib.h>\n"
+	"#include <string.h>\n"
+	"\n"
+	"#define TAPE_SIZE %d\n"
+	"\n"
+	"static unsigned char tape[TAPE_SIZE];\n"
+	"\n"
+	"static void overrun(void) {\n"
+	"\tfprintf(stderr, \"error: tape memory out of bounds (overrun)\\nexceeded the tape size of %%d cells\\n\", TAPE_SIZE);\n"
+	"\texit(EXIT_FAILURE);\n"
+	"}\n"
+	"\n"
+	"static void underrun(void) {\n"
+	"\tfprintf(stderr, \"error: tape memory out of bounds (underrun)\\nundershot the tape size of %%d cells\\n\", TAPE_SIZE);\n"
+	"\texit(EXIT_FAILURE);\n"
+	"}\n"
+	"\n"
+	"int main(void) {\n"
+	"\tunsigned char *p = tape;\n"
+	"\tint c;\n"
+	"\t(void) c; (void) overrun; (void) underrun;\n";
+
+/* The code that follows the translated instructions */
+static const char *brainfuck_emit_epilogue =
+	"\treturn EXIT_SUCCESS;\n"
+	"}\n";
+
+/**
+ * Writes the indentation for the given nesting depth.
+ */
+static void brainfuck_emit_indent(FILE *stream, size_t depth) {
+	size_t i;
+	for (i = 0; i <= depth; i++)
+		fputc('\t', stream);
+}
+
+/**
+ * Writes the C statement that moves the pointer by the given amount.
+ */
+static void brainfuck_emit_move(FILE *stream, size_t depth, int amount) {
+	brainfuck_emit_indent(stream, depth);
+	if (amount > 0)
+		fprintf(stream, "if ((p += %d) >= tape + TAPE_SIZE) overrun();\n", amount);
+	else if (amount < 0)
+		fprintf(stream, "if ((p -= %d) < tape) underrun();\n", -amount);
+}
+
+/**
+ * Writes a self-contained C translation unit to the given stream that performs
+ * 	the given instructions when compiled and run, reading input from stdin and
+ * 	writing output to stdout.
+ *
+ * @param root The start of the linked list of instructions to translate.
+ * @param stream The stream to write the C code to.
+ * @return <code>0</code> on success, otherwise <code>EOF</code>.
+ */
+int brainfuck_emit_c(BrainfuckInstruction *root, FILE *stream) {
+	BrainfuckInstruction *instruction = root;
+	/* The instructions to continue with after each open loop */
+	BrainfuckInstruction **continuations = NULL;
+	size_t depth = 0, size = 0;
+	int amount;
+
+	if (stream == NULL)
+		return EOF;
+	fprintf(stream, brainfuck_emit_prologue, BRAINFUCK_TAPE_SIZE);
+	while (1) {
+		if (instruction == NULL || instruction->type == BRAINFUCK_TOKEN_LOOP_END) {
+			if (depth == 0)
+				break;
+			instruction = continuations[--depth];
+			brainfuck_emit_indent(stream, depth);
+			fputs("}\n", stream);
+			continue;
+		}
+		switch (instruction->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+		case BRAINFUCK_TOKEN_MINUS:
+			amount = instruction->type == BRAINFUCK_TOKEN_PLUS ?
+				instruction->difference : -instruction->difference;
+			if (amount != 0) {
+				brainfuck_emit_indent(stream, depth);
+				fprintf(stream, "*p += %d;\n", amount);
+			}
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			brainfuck_emit_move(stream, depth, instruction->type == BRAINFUCK_TOKEN_NEXT ?
+				instruction->difference : -instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_OUTPUT:
+			for (amount = 0; amount < instruction->difference; amount++) {
+				brainfuck_emit_indent(stream, depth);
+				fputs("putchar(*p);\n", stream);
+			}
+			break;
+		case BRAINFUCK_TOKEN_INPUT:
+			for (amount = 0; amount < instruction->difference; amount++) {
+				brainfuck_emit_indent(stream, depth);
+				if (BRAINFUCK_EOF_BEHAVIOR != 1)
+					fprintf(stream, "*p = (c = getchar()) == EOF ? %d : c;\n", BRAINFUCK_EOF_BEHAVIOR);
+				else
+					fputs("if ((c = getchar()) != EOF) *p = c;\n", stream);
+			}
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+			if (depth == size) {
+				size = size ? size * 2 : 16;
+				continuations = (BrainfuckInstruction **) realloc(continuations,
+						size * sizeof(BrainfuckInstruction *));
+			}
+			brainfuck_emit_indent(stream, depth);
+			fputs(instruction->type == BRAINFUCK_TOKEN_IF ? "if (*p) {\n" : "while (*p) {\n", stream);
+			continuations[depth++] = instruction->next;
+			instruction = instruction->loop;
+			continue;
+		case BRAINFUCK_TOKEN_SET:
+			brainfuck_emit_indent(stream, depth);
+			fprintf(stream, "*p = %d;\n", instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_SCAN:
+			brainfuck_emit_indent(stream, depth);
+			if (instruction->difference == 1)
+				fputs("if (*p && !(p = memchr(p, 0, tape + TAPE_SIZE - p))) overrun();\n", stream);
+			else if (instruction->difference > 0)
+				fprintf(stream, "while (*p) if ((p += %d) >= tape + TAPE_SIZE) overrun();\n",
+					instruction->difference);
+			else
+				fprintf(stream, "while (*p) if ((p -= %d) < tape) underrun();\n",
+					-instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_MULTIPLY:
+			brainfuck_emit_indent(stream, depth);
+			fprintf(stream, "if (*p) { if (p + %d %s) %s(); p[%d] += *p * %d; }\n",
+				instruction->offset, instruction->offset > 0 ? ">= tape + TAPE_SIZE" : "< tape",
+				instruction->offset > 0 ? "overrun" : "underrun",
+				instruction->offset, instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_COUNT:
+			/* Counting takes at most 256 iterations on the 8-bit cells of the generated program */
+			brainfuck_emit_indent(stream, depth);
+			fprintf(stream, "for (c = 0; *p; c++) *p += %d; *p = c;\n", instruction->difference);
+			break;
+		case BRAINFUCK_TOKEN_BREAK:
+			/* The debug extension is only available in the interpreter */
+			break;
+		default:
+			/* Unknown instructions end the list, as they do in brainfuck_execute */
+			instruction = NULL;
+			continue;
+		}
+		instruction = instruction->next;
+	}
+	free(continuations);
+	fputs(brainfuck_emit_epilogue, stream);
+	return ferror(stream) ? EOF : 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Template of the executors, which brainfuck.c includes once for every cell
+ * 	width after defining the macros below, so that every width gets its own
+ * 	executors in which the type of the cells is known at compile time:
+ *
+ * 	BRAINFUCK_CELL            The type of a cell.
+ * 	BRAINFUCK_CELL_NAME(name) The name of an executor for this width.
+ * 	BRAINFUCK_SCAN_RIGHT      The function that scans the tape to the right.
+ * 	BRAINFUCK_SCAN_LEFT       The function that scans the tape to the left.
+ * 	BRAINFUCK_PROFILE         If defined, only the executor of compiled programs
+ * 	                          is instantiated, which counts every operation it
+ * 	                          executes in the counts of the program and the
+ * 	                          strides of every scan in its steps.
+ *
+ * This file deliberately has no include guard.
+ */
+
+/* Moves shorter than this many cells cannot skip the guard regions */
+#define BRAINFUCK_CELL_REACH ((long) (BRAINFUCK_TAPE_GUARD_SIZE / sizeof(BRAINFUCK_CELL)))
+
+#ifdef BRAINFUCK_PROFILE
+#	define BRAINFUCK_PROFILE_OP() counts[op - program->ops]++
+#	define BRAINFUCK_PROFILE_SCAN_START() from = index
+#	define BRAINFUCK_PROFILE_SCAN_END() \
+		steps[op - program->ops] += (unsigned long) (labs(index - from) / op->argument)
+#else
+#	define BRAINFUCK_PROFILE_OP()
+#	define BRAINFUCK_PROFILE_SCAN_START()
+#	define BRAINFUCK_PROFILE_SCAN_END()
+#endif
+
+#ifndef BRAINFUCK_PROFILE
+
+/**
+ * Executes the given linked list containing instructions on a tape of cells
+ * 	of type <code>BRAINFUCK_CELL</code>. Every move is checked, also on
+ * 	guarded tapes, so the program never hits a guard region and the loops
+ * 	that are being executed can always be freed.
+ *
+ * @param root The start of the linked list of instructions to execute.
+ * @param context The context of this execution.
+ * @return The status the execution ended with.
+ */
+static BRAINFUCK_NOINLINE int BRAINFUCK_CELL_NAME(brainfuck_execute)(BrainfuckInstruction *root, BrainfuckExecutionContext *context) {
+	BrainfuckInstruction *instruction = root;
+	/* The loops whose bodies are being executed */
+	BrainfuckInstruction **loops = NULL;
+	size_t depth = 0, capacity = 0;
+	BRAINFUCK_CELL *tape = (BRAINFUCK_CELL *) context->tape;
+	long index = context->tape_index;
+	long size = (long) context->tape_size;
+	long found, move;
+	/* The operations that may run before the budget of the context is refilled */
+	long budget = context->budget;
+	int repeat, status = BRAINFUCK_STATUS_OK;
+	while (1) {
+		if (instruction == NULL || instruction->type == BRAINFUCK_TOKEN_LOOP_END) {
+			if (depth == 0)
+				break;
+			/* The end of a loop body jumps back to its start while the cell is nonzero */
+			if (loops[depth - 1]->type == BRAINFUCK_TOKEN_LOOP_START && tape[index]) {
+				instruction = loops[depth - 1]->loop;
+				BRAINFUCK_BACK_EDGE(1, end);
+				continue;
+			}
+			instruction = loops[--depth];
+		} else switch (instruction->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+			tape[index] += instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_MINUS:
+			tape[index] -= instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			/* Mixed runs like ><< are merged into one move whose difference may be negative */
+			move = instruction->type == BRAINFUCK_TOKEN_NEXT ?
+				(long) instruction->difference : -(long) instruction->difference;
+			if (move >= size - index)
+				goto overrun;
+			if (move < -index)
+				goto underrun;
+			index += move;
+			break;
+		case BRAINFUCK_TOKEN_OUTPUT:
+			if (brainfuck_output(context, tape[index], instruction->difference) != 0)
+				goto io;
+			break;
+		case BRAINFUCK_TOKEN_INPUT:
+			for (repeat = 0; repeat < instruction->difference; repeat++) {
+				int input = brainfuck_input(context);
+				if (input == BRAINFUCK_INPUT_ERROR)
+					goto io;
+				if (input == EOF) {
+					if (BRAINFUCK_EOF_BEHAVIOR != 1)
+						tape[index] = BRAINFUCK_EOF_BEHAVIOR;
+				} else {
+					tape[index] = input;
+				}
+			}
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+			if (!tape[index])
+				break;
+			if (depth == capacity) {
+				capacity = capacity ? capacity * 2 : 16;
+				loops = (BrainfuckInstruction **) realloc(loops, capacity * sizeof(BrainfuckInstruction *));
+			}
+			loops[depth++] = instruction;
+			instruction = instruction->loop;
+			continue;
+		case BRAINFUCK_TOKEN_BREAK:
+			context->tape_index = (int) index;
+			brainfuck_print_tape(context);
+			break;
+		case BRAINFUCK_TOKEN_SET:
+			tape[index] = instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_SCAN:
+			if (!tape[index])
+				break;
+			if (instruction->difference > 0)
+				found = BRAINFUCK_SCAN_RIGHT(tape, index, size, instruction->difference);
+			else
+				found = BRAINFUCK_SCAN_LEFT(tape, index, -instruction->difference);
+			if (found < 0 && instruction->difference > 0)
+				goto overrun;
+			else if (found < 0)
+				goto underrun;
+			index = found;
+			break;
+		case BRAINFUCK_TOKEN_MULTIPLY:
+			if (!tape[index])
+				break;
+			if (index + instruction->offset >= size)
+				goto overrun;
+			if (index + instruction->offset < 0)
+				goto underrun;
+			tape[index + instruction->offset] +=
+				tape[index] * instruction->difference;
+			break;
+		case BRAINFUCK_TOKEN_COUNT:
+			found = brainfuck_count(tape[index], instruction->difference, 8 * sizeof(BRAINFUCK_CELL));
+			/* A loop that never terminates keeps running until execution is stopped */
+			if (found < 0) {
+				BRAINFUCK_BACK_EDGE(1, end);
+				continue;
+			}
+			tape[index] = (BRAINFUCK_CELL) found;
+			break;
+		default:
+			/* Unknown instructions end the list they are part of */
+			instruction = NULL;
+			continue;
+		}
+		instruction = instruction->next;
+		/* Every instruction is charged, but the budget is only checked on back-edges */
+		budget--;
+	}
+	goto end;
+	/* The pointer is left on the end of the tape it ran off */
+overrun:
+	index = size - 1;
+	status = BRAINFUCK_STATUS_OVERRUN;
+	goto fail;
+underrun:
+	index = 0;
+	status = BRAINFUCK_STATUS_UNDERRUN;
+	goto fail;
+io:
+	status = BRAINFUCK_STATUS_IO;
+fail:
+	context->position = instruction->position;
+end:
+	free(loops);
+	context->tape_index = (int) index;
+	context->budget = budget;
+	brainfuck_budget_settle(context);
+	if (brainfuck_flush(context) != 0 && status == BRAINFUCK_STATUS_OK) {
+		context->position.line = 0;
+		context->position.column = 0;
+		status = BRAINFUCK_STATUS_IO;
+	}
+	return status;
+}
+
+#endif /* BRAINFUCK_PROFILE */
+
+/**
+ * Executes the given compiled program on a tape of cells of type
+ * 	<code>BRAINFUCK_CELL</code>.
+ *
+ * @param program The program to execute.
+ * @param context The context of this execution.
+ * @return The status the execution ended with.
+ */
+static BRAINFUCK_NOINLINE int BRAINFUCK_CELL_NAME(brainfuck_execute_program)(BrainfuckProgram *program, BrainfuckExecutionContext *context) {
+	BrainfuckOp *op = program->ops;
+	BRAINFUCK_CELL *tape = (BRAINFUCK_CELL *) context->tape;
+	long index = context->tape_index;
+	long size = (long) context->tape_size;
+	long count;
+	/* The operations that may run before the budget of the context is refilled */
+	long budget = context->budget;
+	int repeat, status = BRAINFUCK_STATUS_OK;
+#ifdef BRAINFUCK_PROFILE
+	unsigned long *counts = program->counts;
+	unsigned long *steps = program->steps;
+	long from;
+#endif
+	if (context->guarded && (status = brainfuck_tape_check(context)) != BRAINFUCK_STATUS_OK)
+		return status;
+	BRAINFUCK_PROFILE_OP();
+#ifdef BRAINFUCK_DISPATCH_THREADED
+	static const void *checked[] = {
+		[BRAINFUCK_OP_END] = &&op_BRAINFUCK_OP_END,
+		[BRAINFUCK_OP_ADD] = &&op_BRAINFUCK_OP_ADD,
+		[BRAINFUCK_OP_RIGHT] = &&op_BRAINFUCK_OP_RIGHT,
+		[BRAINFUCK_OP_LEFT] = &&op_BRAINFUCK_OP_LEFT,
+		[BRAINFUCK_OP_OUTPUT] = &&op_BRAINFUCK_OP_OUTPUT,
+		[BRAINFUCK_OP_INPUT] = &&op_BRAINFUCK_OP_INPUT,
+		[BRAINFUCK_OP_LOOP_START] = &&op_BRAINFUCK_OP_LOOP_START,
+		[BRAINFUCK_OP_LOOP_END] = &&op_BRAINFUCK_OP_LOOP_END,
+		[BRAINFUCK_OP_BREAK] = &&op_BRAINFUCK_OP_BREAK,
+		[BRAINFUCK_OP_SET] = &&op_BRAINFUCK_OP_SET,
+		[BRAINFUCK_OP_SCAN_RIGHT] = &&op_BRAINFUCK_OP_SCAN_RIGHT,
+		[BRAINFUCK_OP_SCAN_LEFT] = &&op_BRAINFUCK_OP_SCAN_LEFT,
+		[BRAINFUCK_OP_MULTIPLY] = &&op_BRAINFUCK_OP_MULTIPLY,
+		[BRAINFUCK_OP_MOVE] = &&op_BRAINFUCK_OP_MOVE,
+		[BRAINFUCK_OP_CHECK] = &&op_BRAINFUCK_OP_CHECK,
+		[BRAINFUCK_OP_COUNT] = &&op_BRAINFUCK_OP_COUNT,
+		[BRAINFUCK_OP_IF] = &&op_BRAINFUCK_OP_IF,
+	};
+	/* Guarded tapes use handlers that leave short moves and ranges unchecked */
+	static const void *guarded[] = {
+		[BRAINFUCK_OP_END] = &&op_BRAINFUCK_OP_END,
+		[BRAINFUCK_OP_ADD] = &&op_BRAINFUCK_OP_ADD,
+		[BRAINFUCK_OP_RIGHT] = &&op_guarded_right,
+		[BRAINFUCK_OP_LEFT] = &&op_guarded_left,
+		[BRAINFUCK_OP_OUTPUT] = &&op_BRAINFUCK_OP_OUTPUT,
+		[BRAINFUCK_OP_INPUT] = &&op_BRAINFUCK_OP_INPUT,
+		[BRAINFUCK_OP_LOOP_START] = &&op_BRAINFUCK_OP_LOOP_START,
+		[BRAINFUCK_OP_LOOP_END] = &&op_BRAINFUCK_OP_LOOP_END,
+		[BRAINFUCK_OP_BREAK] = &&op_BRAINFUCK_OP_BREAK,
+		[BRAINFUCK_OP_SET] = &&op_BRAINFUCK_OP_SET,
+		[BRAINFUCK_OP_SCAN_RIGHT] = &&op_BRAINFUCK_OP_SCAN_RIGHT,
+		[BRAINFUCK_OP_SCAN_LEFT] = &&op_BRAINFUCK_OP_SCAN_LEFT,
+		[BRAINFUCK_OP_MULTIPLY] = &&op_guarded_multiply,
+		[BRAINFUCK_OP_MOVE] = &&op_BRAINFUCK_OP_MOVE,
+		[BRAINFUCK_OP_CHECK] = &&op_guarded_check,
+		[BRAINFUCK_OP_COUNT] = &&op_BRAINFUCK_OP_COUNT,
+		[BRAINFUCK_OP_IF] = &&op_BRAINFUCK_OP_IF,
+	};
+	const void * const *dispatch = context->guarded ? guarded : checked;
+	BRAINFUCK_DISPATCH();
+#else
+	while (1) switch (op->code) {
+#endif
+	BRAINFUCK_OP(BRAINFUCK_OP_ADD)
+		tape[index + op->offset] += op->argument;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_RIGHT)
+		if (op->argument >= size - index)
+			goto overrun;
+		index += op->argument;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_LEFT)
+		if (op->argument > index)
+			goto underrun;
+		index -= op->argument;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_OUTPUT)
+		if (brainfuck_output(context, tape[index + op->offset], op->argument) != 0)
+			goto io;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_INPUT)
+		for (repeat = 0; repeat < op->argument; repeat++) {
+			int input = brainfuck_input(context);
+			if (input == BRAINFUCK_INPUT_ERROR)
+				goto io;
+			if (input == EOF) {
+				if (BRAINFUCK_EOF_BEHAVIOR != 1)
+					tape[index + op->offset] = BRAINFUCK_EOF_BEHAVIOR;
+			} else {
+				tape[index + op->offset] = input;
+			}
+		}
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_LOOP_START)
+		if (!tape[index])
+			op += op->argument;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_LOOP_END)
+		if (tape[index]) {
+			/* Every iteration is charged the length of the body of the loop */
+			BRAINFUCK_BACK_EDGE(-op->argument, end);
+			op += op->argument;
+		}
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_BREAK)
+		context->tape_index = (int) index;
+		brainfuck_print_tape(context);
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_SET)
+		tape[index + op->offset] = op->argument;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_SCAN_RIGHT)
+		BRAINFUCK_PROFILE_SCAN_START();
+		/* Most scans are short, so try as many cells as the compiler chose before using the scan kernels */
+		for (repeat = 0; tape[index] && repeat < op->offset && op->argument < size - index; repeat++)
+			index += op->argument;
+		if (tape[index]) {
+			if ((count = BRAINFUCK_SCAN_RIGHT(tape, index, size, op->argument)) < 0)
+				goto overrun;
+			index = count;
+		}
+		BRAINFUCK_PROFILE_SCAN_END();
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_SCAN_LEFT)
+		BRAINFUCK_PROFILE_SCAN_START();
+		for (repeat = 0; tape[index] && repeat < op->offset && op->argument <= index; repeat++)
+			index -= op->argument;
+		if (tape[index]) {
+			if ((count = BRAINFUCK_SCAN_LEFT(tape, index, op->argument)) < 0)
+				goto underrun;
+			index = count;
+		}
+		BRAINFUCK_PROFILE_SCAN_END();
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_MULTIPLY)
+		if (tape[index]) {
+			if (op->offset >= size - index)
+				goto overrun;
+			if (-op->offset > index)
+				goto underrun;
+			tape[index + op->offset] += tape[index] * op->argument;
+		}
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_MOVE)
+		index += op->argument;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_CHECK)
+		if (op->argument >= size - index)
+			goto overrun;
+		if (-op->offset > index)
+			goto underrun;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_COUNT)
+		count = brainfuck_count(tape[index], op->argument, 8 * sizeof(BRAINFUCK_CELL));
+		/* A loop that never terminates runs this operation until execution is stopped */
+		if (count < 0) {
+			BRAINFUCK_BACK_EDGE(1, end);
+			op--;
+		} else {
+			tape[index] = (BRAINFUCK_CELL) count;
+		}
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_IF)
+		if (!tape[index + op->offset])
+			op += op->argument;
+		BRAINFUCK_NEXT();
+	BRAINFUCK_OP(BRAINFUCK_OP_END)
+		goto end;
+#ifdef BRAINFUCK_DISPATCH_THREADED
+	/* A move within the reach of the guard regions faults when the cell is accessed */
+op_guarded_right:
+	if (op->argument >= BRAINFUCK_CELL_REACH)
+		goto op_BRAINFUCK_OP_RIGHT;
+	index += op->argument;
+	BRAINFUCK_NEXT();
+op_guarded_left:
+	if (op->argument >= BRAINFUCK_CELL_REACH)
+		goto op_BRAINFUCK_OP_LEFT;
+	index -= op->argument;
+	BRAINFUCK_NEXT();
+op_guarded_multiply:
+	if (op->offset >= BRAINFUCK_CELL_REACH || -op->offset >= BRAINFUCK_CELL_REACH)
+		goto op_BRAINFUCK_OP_MULTIPLY;
+	if (tape[index])
+		tape[index + op->offset] += tape[index] * op->argument;
+	BRAINFUCK_NEXT();
+op_guarded_check:
+	if (op->argument >= BRAINFUCK_CELL_REACH || -op->offset >= BRAINFUCK_CELL_REACH)
+		goto op_BRAINFUCK_OP_CHECK;
+	BRAINFUCK_NEXT();
+#else
+	default:
+		goto end;
+	}
+#endif
+	/* The pointer is left on the end of the tape it ran off */
+overrun:
+	index = size - 1;
+	status = BRAINFUCK_STATUS_OVERRUN;
+	goto fail;
+underrun:
+	index = 0;
+	status = BRAINFUCK_STATUS_UNDERRUN;
+	goto fail;
+io:
+	status = BRAINFUCK_STATUS_IO;
+fail:
+	context->position = program->positions[op - program->ops];
+end:
+	context->tape_index = (int) index;
+	context->budget = budget;
+	brainfuck_budget_settle(context);
+	if (context->guarded && status == BRAINFUCK_STATUS_OK)
+		status = brainfuck_tape_check(context);
+	if (brainfuck_flush(context) != 0 && status == BRAINFUCK_STATUS_OK) {
+		context->position.line = 0;
+		context->position.column = 0;
+		status = BRAINFUCK_STATUS_IO;
+	}
+	return status;
+}
+
+
+#undef BRAINFUCK_PROFILE_OP
+#undef BRAINFUCK_PROFILE_SCAN_START
+#undef BRAINFUCK_PROFILE_SCAN_END
+#undef BRAINFUCK_PROFILE
+#undef BRAINFUCK_CELL_REACH
+#undef BRAINFUCK_SCAN_LEFT
+#undef BRAINFUCK_SCAN_RIGHT
+#undef BRAINFUCK_CELL_NAME
+#undef BRAINFUCK_CELL
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <brainfuck.h>
+
+#include "io.h"
+
+/**
+ * Outputs the given character the given amount of times, either by appending
+ * 	it to the output buffer of the context if the context has a write handler
+ * 	or by invoking the output handler of the context.
+ *
+ * @param context The context to output the character to.
+ * @param chr The character to output, of which only the lowest byte is used.
+ * @param count The amount of times to output the character.
+ * @return <code>0</code> on success, otherwise <code>-1</code> if the output
+ * 	handler returned <code>EOF</code> or the write handler failed.
+ */
+int brainfuck_output(BrainfuckExecutionContext *context, int chr, int count) {
+	size_t length;
+	if (context->write_handler == NULL) {
+		for (; count > 0; count--)
+			if (context->output_handler((unsigned char) chr) == EOF)
+				return -1;
+		return 0;
+	}
+	while (count > 0) {
+		if (context->output_length == BRAINFUCK_OUTPUT_BUFFER_SIZE && brainfuck_flush(context) != 0)
+			return -1;
+		length = BRAINFUCK_OUTPUT_BUFFER_SIZE - context->output_length;
+		if (length > (size_t) count)
+			length = (size_t) count;
+		memset(context->output + context->output_length, chr, length);
+		context->output_length += length;
+		count -= (int) length;
+	}
+	return 0;
+}
+
+/**
+ * Reads a byte from the input buffer of the context if the context has a read
+ * 	handler or using the input handler of the context otherwise. The buffered
+ * 	output is flushed before input is requested, so prompts are visible.
+ *
+ * @param context The context to read the byte from.
+ * @return The byte that is read as <code>unsigned char</code>,
+ * 	<code>EOF</code> at the end of the input or
+ * 	<code>BRAINFUCK_INPUT_ERROR</code> if reading the input or writing the
+ * 	buffered output failed.
+ */
+int brainfuck_input(BrainfuckExecutionContext *context) {
+	long result;
+	char chr;
+	if (context->read_handler == NULL) {
+		if (brainfuck_flush(context) != 0)
+			return BRAINFUCK_INPUT_ERROR;
+		/* The input handler cannot tell a 0xFF byte apart from EOF */
+		chr = context->input_handler();
+		return chr == EOF ? EOF : (unsigned char) chr;
+	}
+	if (context->input_position == context->input_length) {
+		if (brainfuck_flush(context) != 0)
+			return BRAINFUCK_INPUT_ERROR;
+		result = context->read_handler(context->input, BRAINFUCK_INPUT_BUFFER_SIZE);
+		if (result < 0)
+			return BRAINFUCK_INPUT_ERROR;
+		if (result == 0)
+			return EOF;
+		context->input_length = (size_t) result;
+		context->input_position = 0;
+	}
+	return (unsigned char) context->input[context->input_position++];
+}
+
+/**
+ * Passes the buffered output of the given context to its write handler.
+ *
+ * @param context The context of which the output should be flushed.
+ * @return <code>0</code> on success, otherwise <code>-1</code> if the write
+ * 	handler failed, in which case the rest of the output is dropped.
+ */
+int brainfuck_flush(BrainfuckExecutionContext *context) {
+	size_t written = 0;
+	long result;
+	if (context == NULL || context->write_handler == NULL)
+		return 0;
+	while (written < context->output_length) {
+		result = context->write_handler(context->output + written,
+			context->output_length - written);
+		if (result <= 0) {
+			context->output_length = 0;
+			return -1;
+		}
+		written += (size_t) result;
+	}
+	context->output_length = 0;
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BRAINFUCK_IO_H
+#define BRAINFUCK_IO_H
+
+#include <brainfuck.h>
+
+/* Returned by brainfuck_input when input or output fails, unlike EOF at the end of the input */
+#define BRAINFUCK_INPUT_ERROR (-2)
+
+/**
+ * Outputs the given character the given amount of times, either by appending
+ * 	it to the output buffer of the context if the context has a write handler
+ * 	or by invoking the output handler of the context.
+ *
+ * @param context The context to output the character to.
+ * @param chr The character to output, of which only the lowest byte is used.
+ * @param count The amount of times to output the character.
+ * @return <code>0</code> on success, otherwise <code>-1</code> if the output
+ * 	handler returned <code>EOF</code> or the write handler failed.
+ */
+int brainfuck_output(BrainfuckExecutionContext *, int, int);
+
+/**
+ * Reads a byte from the input buffer of the context if the context has a read
+ * 	handler or using the input handler of the context otherwise. The buffered
+ * 	output is flushed before input is requested, so prompts are visible.
+ *
+ * @param context The context to read the byte from.
+ * @return The byte that is read as <code>unsigned char</code>,
+ * 	<code>EOF</code> at the end of the input or
+ * 	<code>BRAINFUCK_INPUT_ERROR</code> if reading the input or writing the
+ * 	buffered output failed.
+ */
+int brainfuck_input(BrainfuckExecutionContext *);
+
+#endif /* BRAINFUCK_IO_H */
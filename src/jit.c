@@ -0,0 +1,757 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <brainfuck.h>
+
+#include "budget.h"
+#include "count.h"
+#include "io.h"
+#include "scan.h"
+#include "tape.h"
+
+/*
+ * The just-in-time compiler translates compiled programs into x86-64 machine
+ * 	code for the System V calling convention. Other platforms fall back to
+ * 	the interpreter.
+ */
+#if defined(__x86_64__) && defined(__linux__)
+#	define BRAINFUCK_JIT_X86_64
+#	include <stdint.h>
+#	include <sys/mman.h>
+#endif
+
+#ifdef BRAINFUCK_JIT_X86_64
+
+/**
+ * The signature of the generated code, which is called with the context, the
+ * 	address of the current cell and the addresses of the start and the end of
+ * 	the tape, and returns one of the <code>BRAINFUCK_STATUS_*</code> values.
+ */
+typedef int (*BrainfuckJitFunction) (BrainfuckExecutionContext *, unsigned char *,
+	unsigned char *, unsigned char *);
+
+/**
+ * A jump out of the generated code when an operation fails, which goes
+ * 	through a stub that records the operation in the context.
+ */
+typedef struct BrainfuckJitExit {
+	/**
+	 * The position of the displacement of the jump in the buffer.
+	 */
+	size_t jump;
+	/**
+	 * The status the exit returns.
+	 */
+	int status;
+	/**
+	 * The position in the source of the operation that fails.
+	 */
+	BrainfuckPosition position;
+	/**
+	 * Whether the budget is kept in the context instead of r15 at the jump.
+	 */
+	int spilled;
+} BrainfuckJitExit;
+
+/**
+ * A buffer that machine code is generated into.
+ */
+typedef struct BrainfuckJitBuffer {
+	/**
+	 * The generated code.
+	 */
+	unsigned char *code;
+	/**
+	 * The amount of bytes that have been generated.
+	 */
+	size_t length;
+	/**
+	 * The amount of bytes <code>code</code> has room for.
+	 */
+	size_t capacity;
+	/**
+	 * The size of the cells of the tape in bytes.
+	 */
+	int cell;
+	/**
+	 * The exits of the operations that are generated, of which the stubs
+	 * 	follow the code of the program.
+	 */
+	BrainfuckJitExit *exits;
+	/**
+	 * The amount of exits in <code>exits</code>.
+	 */
+	size_t exit_count;
+	/**
+	 * The amount of exits <code>exits</code> has room for.
+	 */
+	size_t exit_capacity;
+	/**
+	 * The position in the source of the operation that is being generated.
+	 */
+	BrainfuckPosition position;
+	/**
+	 * Whether the budget is kept in the context instead of r15 at the moment.
+	 */
+	int spilled;
+} BrainfuckJitBuffer;
+
+/**
+ * Appends the given bytes to the buffer.
+ */
+static void brainfuck_jit_emit(BrainfuckJitBuffer *buffer, const char *bytes, size_t length) {
+	if (buffer->length + length > buffer->capacity) {
+		while (buffer->length + length > buffer->capacity)
+			buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+		buffer->code = (unsigned char *) realloc(buffer->code, buffer->capacity);
+	}
+	memcpy(buffer->code + buffer->length, bytes, length);
+	buffer->length += length;
+}
+
+/**
+ * Appends a 32-bit little-endian integer to the buffer.
+ */
+static void brainfuck_jit_emit_int(BrainfuckJitBuffer *buffer, int32_t value) {
+	char bytes[4];
+	bytes[0] = (char) (value & 0xFF);
+	bytes[1] = (char) ((value >> 8) & 0xFF);
+	bytes[2] = (char) ((value >> 16) & 0xFF);
+	bytes[3] = (char) ((value >> 24) & 0xFF);
+	brainfuck_jit_emit(buffer, bytes, 4);
+}
+
+/**
+ * Appends a 64-bit little-endian integer to the buffer.
+ */
+static void brainfuck_jit_emit_long(BrainfuckJitBuffer *buffer, uint64_t value) {
+	brainfuck_jit_emit_int(buffer, (int32_t) (value & 0xFFFFFFFF));
+	brainfuck_jit_emit_int(buffer, (int32_t) (value >> 32));
+}
+
+/**
+ * Appends the opcode of an instruction that operates on a cell, using the byte
+ * 	form for 8-bit cells and the wide form, preceded by the operand size
+ * 	prefix for 16-bit cells, otherwise. The operand follows.
+ */
+static void brainfuck_jit_emit_cell(BrainfuckJitBuffer *buffer, char byte, char wide) {
+	if (buffer->cell == 1) {
+		brainfuck_jit_emit(buffer, &byte, 1);
+		return;
+	}
+	if (buffer->cell == 2)
+		brainfuck_jit_emit(buffer, "\x66", 1);
+	brainfuck_jit_emit(buffer, &wide, 1);
+}
+
+/**
+ * Appends the operand that addresses the cell at the given offset from the
+ * 	current cell, using the shortest displacement that fits.
+ *
+ * @param buffer The buffer to append to.
+ * @param reg The register or opcode extension of the instruction.
+ * @param offset The offset of the cell, of which the displacement in bytes
+ * 	has to fit in 32 bits.
+ */
+static void brainfuck_jit_emit_address(BrainfuckJitBuffer *buffer, int reg, int offset) {
+	int32_t bytes = (int32_t) ((int64_t) offset * buffer->cell);
+	char modrm = (char) (reg << 3 | 0x03);
+	if (bytes == 0) {
+		brainfuck_jit_emit(buffer, &modrm, 1);               /* [rbx] */
+	} else if (bytes >= -128 && bytes <= 127) {
+		modrm |= 0x40;
+		brainfuck_jit_emit(buffer, &modrm, 1);               /* [rbx + disp8] */
+		brainfuck_jit_emit(buffer, (const char[]) { (char) bytes }, 1);
+	} else {
+		modrm |= (char) 0x80;
+		brainfuck_jit_emit(buffer, &modrm, 1);               /* [rbx + disp32] */
+		brainfuck_jit_emit_int(buffer, bytes);
+	}
+}
+
+/**
+ * Appends an immediate of the size of a cell to the buffer.
+ */
+static void brainfuck_jit_emit_value(BrainfuckJitBuffer *buffer, int value) {
+	char bytes[4];
+	int i;
+	for (i = 0; i < buffer->cell; i++)
+		bytes[i] = (char) ((value >> (8 * i)) & 0xFF);
+	brainfuck_jit_emit(buffer, bytes, buffer->cell);
+}
+
+/**
+ * Appends the 32-bit displacement in bytes of the given amount of cells.
+ *
+ * @return <code>1</code> if the displacement fits in 32 bits, otherwise <code>0</code>.
+ */
+static int brainfuck_jit_emit_cells(BrainfuckJitBuffer *buffer, int cells) {
+	int64_t bytes = (int64_t) cells * buffer->cell;
+	if (bytes > INT32_MAX || bytes < INT32_MIN)
+		return 0;
+	brainfuck_jit_emit_int(buffer, (int32_t) bytes);
+	return 1;
+}
+
+/**
+ * Appends the code that loads the current cell zero-extended into eax.
+ */
+static void brainfuck_jit_emit_load(BrainfuckJitBuffer *buffer) {
+	if (buffer->cell == 1)
+		brainfuck_jit_emit(buffer, "\x0F\xB6\x03", 3);       /* movzx eax, byte [rbx] */
+	else if (buffer->cell == 2)
+		brainfuck_jit_emit(buffer, "\x0F\xB7\x03", 3);       /* movzx eax, word [rbx] */
+	else
+		brainfuck_jit_emit(buffer, "\x8B\x03", 2);           /* mov eax, dword [rbx] */
+}
+
+/**
+ * Appends a jump with a 32-bit displacement to the buffer.
+ *
+ * @param buffer The buffer to append to.
+ * @param opcode The opcode of the jump.
+ * @param length The length of the opcode.
+ * @param target The position of the jump target in the buffer, or
+ * 	<code>0</code> if the displacement will be patched later.
+ * @return The position of the displacement in the buffer.
+ */
+static size_t brainfuck_jit_emit_jump(BrainfuckJitBuffer *buffer, const char *opcode,
+		size_t length, size_t target) {
+	size_t position;
+	brainfuck_jit_emit(buffer, opcode, length);
+	position = buffer->length;
+	brainfuck_jit_emit_int(buffer, target ? (int32_t) (target - (position + 4)) : 0);
+	return position;
+}
+
+/**
+ * Points the displacement at the given position in the buffer to the given target.
+ */
+static void brainfuck_jit_patch(BrainfuckJitBuffer *buffer, size_t position, size_t target) {
+	int32_t displacement = (int32_t) (target - (position + 4));
+	size_t length = buffer->length;
+	buffer->length = position;
+	brainfuck_jit_emit_int(buffer, displacement);
+	buffer->length = length;
+}
+
+/**
+ * Appends a jump that leaves the code with the given status when the operation
+ * 	that is being generated fails. The jump goes to a stub that is appended
+ * 	after the program by <code>brainfuck_jit_emit_stubs</code>.
+ *
+ * @param buffer The buffer to append to.
+ * @param opcode The opcode of the conditional jump, which is two bytes long.
+ * @param status The status to return.
+ */
+static void brainfuck_jit_emit_exit(BrainfuckJitBuffer *buffer, const char *opcode, int status) {
+	BrainfuckJitExit *record;
+	if (buffer->exit_count == buffer->exit_capacity) {
+		buffer->exit_capacity = buffer->exit_capacity ? buffer->exit_capacity * 2 : 64;
+		buffer->exits = (BrainfuckJitExit *) realloc(buffer->exits,
+			buffer->exit_capacity * sizeof(BrainfuckJitExit));
+	}
+	record = &buffer->exits[buffer->exit_count++];
+	record->jump = brainfuck_jit_emit_jump(buffer, opcode, 2, 0);
+	record->status = status;
+	record->position = buffer->position;
+	record->spilled = buffer->spilled;
+}
+
+/**
+ * Appends a call to the function at the given address.
+ */
+static void brainfuck_jit_emit_call(BrainfuckJitBuffer *buffer, void (*function)(void)) {
+	brainfuck_jit_emit(buffer, "\x48\xB8", 2);               /* mov rax, imm64 */
+	brainfuck_jit_emit_long(buffer, (uint64_t) (uintptr_t) function);
+	brainfuck_jit_emit(buffer, "\xFF\xD0", 2);               /* call rax */
+}
+
+/**
+ * Appends the given move between r15 and the budget of the context.
+ */
+static void brainfuck_jit_emit_budget(BrainfuckJitBuffer *buffer, const char *opcode) {
+	brainfuck_jit_emit(buffer, opcode, 4);
+	brainfuck_jit_emit_int(buffer, (int32_t) offsetof(BrainfuckExecutionContext, budget));
+}
+
+/**
+ * Appends the check of a back-edge, which exits to the given position if
+ * 	execution is stopped, takes the given cost from the budget of the context
+ * 	and jumps to the given target unless the budget is used up and cannot be
+ * 	refilled, in which case it exits to the other given position.
+ */
+static void brainfuck_jit_emit_back_edge(BrainfuckJitBuffer *buffer, int cost, size_t target,
+		size_t stopped, size_t exhausted) {
+	/* Aligned loads are atomic on x86-64, so this reads the flag like BRAINFUCK_LOAD_STOP */
+	brainfuck_jit_emit(buffer, "\x41\x83\xBC\x24", 4);       /* cmp dword [r12 + disp32], 1 */
+	brainfuck_jit_emit_int(buffer, (int32_t) offsetof(BrainfuckExecutionContext, shouldStop));
+	brainfuck_jit_emit(buffer, "\x01", 1);
+	brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, stopped); /* je stopped */
+	brainfuck_jit_emit(buffer, "\x49\x81\xEF", 3);           /* sub r15, imm32 */
+	brainfuck_jit_emit_int(buffer, cost);
+	brainfuck_jit_emit_jump(buffer, "\x0F\x89", 2, target);  /* jns target */
+	brainfuck_jit_emit_budget(buffer, "\x4D\x89\xBC\x24");    /* mov [r12 + budget], r15 */
+	brainfuck_jit_emit(buffer, "\x4C\x89\xE7", 3);           /* mov rdi, r12 */
+	brainfuck_jit_emit_call(buffer, (void (*)(void)) &brainfuck_budget_refill);
+	brainfuck_jit_emit_budget(buffer, "\x4D\x8B\xBC\x24");    /* mov r15, [r12 + budget] */
+	brainfuck_jit_emit(buffer, "\x85\xC0", 2);               /* test eax, eax */
+	brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, target);  /* je target */
+	brainfuck_jit_emit_jump(buffer, "\xE9", 1, exhausted);     /* jmp exhausted */
+}
+
+/**
+ * Appends the given code on the cell at the given offset <code>count</code>
+ * 	times, using a loop counted in r15 if the code has to be repeated, for
+ * 	which the budget is put back into the context in the meantime.
+ */
+static void brainfuck_jit_emit_repeated(BrainfuckJitBuffer *buffer, int count, int offset,
+		void (*emit)(BrainfuckJitBuffer *, int)) {
+	size_t start;
+	if (count <= 1) {
+		emit(buffer, offset);
+		return;
+	}
+	brainfuck_jit_emit_budget(buffer, "\x4D\x89\xBC\x24");    /* mov [r12 + budget], r15 */
+	brainfuck_jit_emit(buffer, "\x41\xBF", 2);               /* mov r15d, imm32 */
+	brainfuck_jit_emit_int(buffer, count);
+	start = buffer->length;
+	buffer->spilled = 1;
+	emit(buffer, offset);
+	buffer->spilled = 0;
+	brainfuck_jit_emit(buffer, "\x41\xFF\xCF", 3);           /* dec r15d */
+	brainfuck_jit_emit_jump(buffer, "\x0F\x85", 2, start);   /* jnz start */
+	brainfuck_jit_emit_budget(buffer, "\x4D\x8B\xBC\x24");    /* mov r15, [r12 + budget] */
+}
+
+/**
+ * Appends the code that outputs the cell at the given offset the given amount
+ * 	of times.
+ */
+static void brainfuck_jit_emit_output(BrainfuckJitBuffer *buffer, int count, int offset) {
+	brainfuck_jit_emit(buffer, "\x4C\x89\xE7", 3);           /* mov rdi, r12 */
+	/* Only the lowest byte is output, which comes first on little-endian machines */
+	brainfuck_jit_emit(buffer, "\x0F\xB6", 2);               /* movzx esi, byte [cell] */
+	brainfuck_jit_emit_address(buffer, 6, offset);
+	brainfuck_jit_emit(buffer, "\xBA", 1);                   /* mov edx, imm32 */
+	brainfuck_jit_emit_int(buffer, count);
+	brainfuck_jit_emit_call(buffer, (void (*)(void)) &brainfuck_output);
+	brainfuck_jit_emit(buffer, "\x85\xC0", 2);               /* test eax, eax */
+	brainfuck_jit_emit_exit(buffer, "\x0F\x85", BRAINFUCK_STATUS_IO); /* jne io */
+}
+
+/**
+ * Appends the code that reads a character into the cell at the given offset.
+ */
+static void brainfuck_jit_emit_input(BrainfuckJitBuffer *buffer, int offset) {
+	size_t skip = 0;
+	brainfuck_jit_emit(buffer, "\x4C\x89\xE7", 3);           /* mov rdi, r12 */
+	brainfuck_jit_emit_call(buffer, (void (*)(void)) &brainfuck_input);
+	brainfuck_jit_emit(buffer, "\x83\xF8", 2);               /* cmp eax, INPUT_ERROR */
+	brainfuck_jit_emit(buffer, (const char[]) { (char) BRAINFUCK_INPUT_ERROR }, 1);
+	brainfuck_jit_emit_exit(buffer, "\x0F\x84", BRAINFUCK_STATUS_IO); /* je io */
+	brainfuck_jit_emit(buffer, "\x83\xF8\xFF", 3);           /* cmp eax, EOF */
+	if (BRAINFUCK_EOF_BEHAVIOR != 1) {
+		brainfuck_jit_emit(buffer, "\x75\x05", 2);           /* jne +5 */
+		brainfuck_jit_emit(buffer, "\xB8", 1);               /* mov eax, imm32 */
+		brainfuck_jit_emit_int(buffer, BRAINFUCK_EOF_BEHAVIOR);
+	} else {
+		brainfuck_jit_emit(buffer, "\x74\x00", 2);           /* je past the store */
+		skip = buffer->length;
+	}
+	brainfuck_jit_emit_cell(buffer, (char) 0x88, (char) 0x89); /* mov [cell], eax */
+	brainfuck_jit_emit_address(buffer, 0, offset);
+	if (skip)
+		buffer->code[skip - 1] = (unsigned char) (buffer->length - skip);
+}
+
+/**
+ * Appends the stubs of the exits of the program, which record the position of
+ * 	the operation that fails in the context and leave the code with the status
+ * 	of the exit at the given position.
+ */
+static void brainfuck_jit_emit_stubs(BrainfuckJitBuffer *buffer, size_t leave) {
+	BrainfuckJitExit *record;
+	size_t i;
+	for (i = 0; i < buffer->exit_count; i++) {
+		record = &buffer->exits[i];
+		brainfuck_jit_patch(buffer, record->jump, buffer->length);
+		if (record->spilled)
+			brainfuck_jit_emit_budget(buffer, "\x4D\x8B\xBC\x24"); /* mov r15, [r12 + budget] */
+		brainfuck_jit_emit(buffer, "\x41\xC7\x84\x24", 4);   /* mov dword [r12 + disp32], imm32 */
+		brainfuck_jit_emit_int(buffer, (int32_t) offsetof(BrainfuckExecutionContext, position.line));
+		brainfuck_jit_emit_int(buffer, record->position.line);
+		brainfuck_jit_emit(buffer, "\x41\xC7\x84\x24", 4);   /* mov dword [r12 + disp32], imm32 */
+		brainfuck_jit_emit_int(buffer, (int32_t) offsetof(BrainfuckExecutionContext, position.column));
+		brainfuck_jit_emit_int(buffer, record->position.column);
+		brainfuck_jit_emit(buffer, "\xB8", 1);               /* mov eax, status */
+		brainfuck_jit_emit_int(buffer, record->status);
+		brainfuck_jit_emit_jump(buffer, "\xE9", 1, leave);   /* jmp leave */
+	}
+}
+
+/**
+ * Translates the given program into machine code for a tape with cells of the
+ * 	size given by the buffer.
+ *
+ * The generated code keeps the address of the current cell in rbx, the
+ * 	context in r12, the start and end of the tape in r13 and r14 and the
+ * 	budget of the context in r15. Operations that fail jump to stubs after
+ * 	the program, which store their position in the context.
+ *
+ * @param program The program to translate.
+ * @param buffer The buffer to generate the code into.
+ * @param guarded Whether the tape is guarded, so that short moves need no checks.
+ * @return <code>1</code> if the program could be translated, otherwise <code>0</code>.
+ */
+static int brainfuck_jit_translate(BrainfuckProgram *program, BrainfuckJitBuffer *buffer, int guarded) {
+	size_t *loops = (size_t *) malloc(program->length * sizeof(size_t));
+	/* The operation each open branch jumps to, or 0 for loops */
+	size_t *ends = (size_t *) malloc(program->length * sizeof(size_t));
+	/* The position of the code of each operation, which back-edges jump to */
+	size_t *positions = (size_t *) malloc(program->length * sizeof(size_t));
+	size_t depth = 0, start, done, stopped, exhausted, finish, leave, probe, probed, i;
+	/* Moves shorter than this many cells cannot skip the guard regions */
+	int reach = guarded ? BRAINFUCK_TAPE_GUARD_SIZE / buffer->cell : 0;
+	/* The scale of the index register when addressing a cell */
+	char scale = (char) (buffer->cell == 1 ? 0x05 : buffer->cell == 2 ? 0x45 : 0x85);
+	char shift = (char) (buffer->cell == 1 ? 0 : buffer->cell == 2 ? 1 : 2);
+	BrainfuckOp *op;
+
+	/* Prologue, which keeps the stack 16-byte aligned for calls */
+	brainfuck_jit_emit(buffer, "\x53\x41\x54\x41\x55\x41\x56\x41\x57", 9); /* push rbx, r12-r15 */
+	brainfuck_jit_emit(buffer, "\x49\x89\xFC", 3);           /* mov r12, rdi */
+	brainfuck_jit_emit(buffer, "\x48\x89\xF3", 3);           /* mov rbx, rsi */
+	brainfuck_jit_emit(buffer, "\x49\x89\xD5", 3);           /* mov r13, rdx */
+	brainfuck_jit_emit(buffer, "\x49\x89\xCE", 3);           /* mov r14, rcx */
+	brainfuck_jit_emit_budget(buffer, "\x4D\x8B\xBC\x24");    /* mov r15, [r12 + budget] */
+	start = brainfuck_jit_emit_jump(buffer, "\xE9", 1, 0);  /* jmp body */
+
+	/* Exits, placed before the body so the body can jump back to them */
+	stopped = buffer->length;
+	brainfuck_jit_emit(buffer, "\xB8", 1);                   /* mov eax, STOPPED */
+	brainfuck_jit_emit_int(buffer, BRAINFUCK_STATUS_STOPPED);
+	brainfuck_jit_emit(buffer, "\xEB\x0C", 2);               /* jmp leave */
+	exhausted = buffer->length;
+	brainfuck_jit_emit(buffer, "\xB8", 1);                   /* mov eax, BUDGET */
+	brainfuck_jit_emit_int(buffer, BRAINFUCK_STATUS_BUDGET);
+	brainfuck_jit_emit(buffer, "\xEB\x05", 2);               /* jmp leave */
+	finish = buffer->length;
+	brainfuck_jit_emit(buffer, "\xB8", 1);                   /* mov eax, OK */
+	brainfuck_jit_emit_int(buffer, BRAINFUCK_STATUS_OK);
+	leave = buffer->length;
+	brainfuck_jit_emit(buffer, "\x48\x89\xD9", 3);           /* mov rcx, rbx */
+	brainfuck_jit_emit(buffer, "\x4C\x29\xE9", 3);           /* sub rcx, r13 */
+	if (shift) {
+		brainfuck_jit_emit(buffer, "\x48\xC1\xE9", 3);       /* shr rcx, imm8 */
+		brainfuck_jit_emit(buffer, &shift, 1);
+	}
+	brainfuck_jit_emit(buffer, "\x41\x89\x8C\x24", 4);       /* mov [r12 + disp32], ecx */
+	brainfuck_jit_emit_int(buffer, (int32_t) offsetof(BrainfuckExecutionContext, tape_index));
+	brainfuck_jit_emit_budget(buffer, "\x4D\x89\xBC\x24");    /* mov [r12 + budget], r15 */
+	brainfuck_jit_emit(buffer, "\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5B", 9); /* pop r15-r12, rbx */
+	brainfuck_jit_emit(buffer, "\xC3", 1);                   /* ret */
+	brainfuck_jit_patch(buffer, start, buffer->length);
+
+	for (i = 0; i < program->length; i++) {
+		op = &program->ops[i];
+		positions[i] = buffer->length;
+		buffer->position = program->positions[i];
+		/* Branches end without an operation of their own */
+		while (depth > 0 && ends[depth - 1] == i)
+			brainfuck_jit_patch(buffer, loops[--depth], buffer->length);
+		if ((int64_t) op->offset * buffer->cell > INT32_MAX || (int64_t) op->offset * buffer->cell < INT32_MIN)
+			goto unsupported;
+		switch (op->code) {
+		case BRAINFUCK_OP_ADD:
+			brainfuck_jit_emit_cell(buffer, (char) 0x80, (char) 0x81); /* add [cell], imm */
+			brainfuck_jit_emit_address(buffer, 0, op->offset);
+			brainfuck_jit_emit_value(buffer, op->argument);
+			break;
+		case BRAINFUCK_OP_RIGHT:
+			brainfuck_jit_emit(buffer, "\x48\x81\xC3", 3);   /* add rbx, imm32 */
+			if (!brainfuck_jit_emit_cells(buffer, op->argument))
+				goto unsupported;
+			if (op->argument < reach)
+				break;
+			brainfuck_jit_emit(buffer, "\x4C\x39\xF3", 3);   /* cmp rbx, r14 */
+			brainfuck_jit_emit_exit(buffer, "\x0F\x83", BRAINFUCK_STATUS_OVERRUN); /* jae overrun */
+			break;
+		case BRAINFUCK_OP_LEFT:
+			brainfuck_jit_emit(buffer, "\x48\x81\xEB", 3);   /* sub rbx, imm32 */
+			if (!brainfuck_jit_emit_cells(buffer, op->argument))
+				goto unsupported;
+			if (op->argument < reach)
+				break;
+			brainfuck_jit_emit(buffer, "\x4C\x39\xEB", 3);   /* cmp rbx, r13 */
+			brainfuck_jit_emit_exit(buffer, "\x0F\x82", BRAINFUCK_STATUS_UNDERRUN); /* jb underrun */
+			break;
+		case BRAINFUCK_OP_OUTPUT:
+			brainfuck_jit_emit_output(buffer, op->argument, op->offset);
+			break;
+		case BRAINFUCK_OP_INPUT:
+			brainfuck_jit_emit_repeated(buffer, op->argument, op->offset, &brainfuck_jit_emit_input);
+			break;
+		case BRAINFUCK_OP_LOOP_START:
+			brainfuck_jit_emit_cell(buffer, (char) 0x80, (char) 0x83); /* cmp [rbx], 0 */
+			brainfuck_jit_emit(buffer, "\x3B\x00", 2);
+			ends[depth] = 0;
+			loops[depth++] = brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, 0); /* je end */
+			break;
+		case BRAINFUCK_OP_IF:
+			brainfuck_jit_emit_cell(buffer, (char) 0x80, (char) 0x83); /* cmp [cell], 0 */
+			brainfuck_jit_emit_address(buffer, 7, op->offset);
+			brainfuck_jit_emit(buffer, "\x00", 1);
+			ends[depth] = i + op->argument + 1;
+			loops[depth++] = brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, 0); /* je end */
+			break;
+		case BRAINFUCK_OP_LOOP_END:
+			start = loops[--depth];
+			brainfuck_jit_emit_cell(buffer, (char) 0x80, (char) 0x83); /* cmp [rbx], 0 */
+			brainfuck_jit_emit(buffer, "\x3B\x00", 2);
+			done = brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, 0); /* je done */
+			/* Stopping and the budget are checked on the back-edges, so every loop can be interrupted */
+			/* The back-edge skips the check on entry, like the interpreter */
+			brainfuck_jit_emit_back_edge(buffer, -op->argument, positions[i + op->argument + 1],
+				stopped, exhausted);
+			brainfuck_jit_patch(buffer, start, buffer->length);
+			brainfuck_jit_patch(buffer, done, buffer->length);
+			break;
+		case BRAINFUCK_OP_SET:
+			brainfuck_jit_emit_cell(buffer, (char) 0xC6, (char) 0xC7); /* mov [cell], imm */
+			brainfuck_jit_emit_address(buffer, 0, op->offset);
+			brainfuck_jit_emit_value(buffer, op->argument);
+			break;
+		case BRAINFUCK_OP_SCAN_RIGHT:
+		case BRAINFUCK_OP_SCAN_LEFT:
+			brainfuck_jit_emit_cell(buffer, (char) 0x80, (char) 0x83); /* cmp [rbx], 0 */
+			brainfuck_jit_emit(buffer, "\x3B\x00", 2);
+			start = brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, 0); /* je done */
+			probed = 0;
+			if (op->offset > 0) {
+				/* Try the cells one by one first, counted in ecx, like the interpreter */
+				brainfuck_jit_emit(buffer, "\xB9", 1);       /* mov ecx, imm32 */
+				brainfuck_jit_emit_int(buffer, op->offset);
+				probe = buffer->length;
+				brainfuck_jit_emit(buffer, op->code == BRAINFUCK_OP_SCAN_RIGHT ?
+					"\x48\x81\xC3" : "\x48\x81\xEB", 3);   /* add/sub rbx, imm32 */
+				if (!brainfuck_jit_emit_cells(buffer, op->argument))
+					goto unsupported;
+				if (op->argument >= reach && op->code == BRAINFUCK_OP_SCAN_RIGHT) {
+					brainfuck_jit_emit(buffer, "\x4C\x39\xF3", 3); /* cmp rbx, r14 */
+					brainfuck_jit_emit_exit(buffer, "\x0F\x83", BRAINFUCK_STATUS_OVERRUN); /* jae overrun */
+				} else if (op->argument >= reach) {
+					brainfuck_jit_emit(buffer, "\x4C\x39\xEB", 3); /* cmp rbx, r13 */
+					brainfuck_jit_emit_exit(buffer, "\x0F\x82", BRAINFUCK_STATUS_UNDERRUN); /* jb underrun */
+				}
+				brainfuck_jit_emit_cell(buffer, (char) 0x80, (char) 0x83); /* cmp [rbx], 0 */
+				brainfuck_jit_emit(buffer, "\x3B\x00", 2);
+				probed = brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, 0); /* je done */
+				brainfuck_jit_emit(buffer, "\xFF\xC9", 2);   /* dec ecx */
+				brainfuck_jit_emit_jump(buffer, "\x0F\x85", 2, probe); /* jnz probe */
+			}
+			brainfuck_jit_emit(buffer, "\x4C\x89\xEF", 3);   /* mov rdi, r13 */
+			brainfuck_jit_emit(buffer, "\x48\x89\xDE", 3);   /* mov rsi, rbx */
+			brainfuck_jit_emit(buffer, "\x4C\x29\xEE", 3);   /* sub rsi, r13 */
+			if (shift) {
+				brainfuck_jit_emit(buffer, "\x48\xC1\xEE", 3); /* shr rsi, imm8 */
+				brainfuck_jit_emit(buffer, &shift, 1);
+			}
+			if (op->code == BRAINFUCK_OP_SCAN_RIGHT) {
+				brainfuck_jit_emit(buffer, "\x4C\x89\xF2", 3); /* mov rdx, r14 */
+				brainfuck_jit_emit(buffer, "\x4C\x29\xEA", 3); /* sub rdx, r13 */
+				if (shift) {
+					brainfuck_jit_emit(buffer, "\x48\xC1\xEA", 3); /* shr rdx, imm8 */
+					brainfuck_jit_emit(buffer, &shift, 1);
+				}
+				brainfuck_jit_emit(buffer, "\x48\xC7\xC1", 3); /* mov rcx, imm32 */
+				brainfuck_jit_emit_int(buffer, op->argument);
+				brainfuck_jit_emit_call(buffer, buffer->cell == 1 ? (void (*)(void)) &brainfuck_scan_right :
+					buffer->cell == 2 ? (void (*)(void)) &brainfuck_scan_right_16 :
+					(void (*)(void)) &brainfuck_scan_right_32);
+			} else {
+				brainfuck_jit_emit(buffer, "\x48\xC7\xC2", 3); /* mov rdx, imm32 */
+				brainfuck_jit_emit_int(buffer, op->argument);
+				brainfuck_jit_emit_call(buffer, buffer->cell == 1 ? (void (*)(void)) &brainfuck_scan_left :
+					buffer->cell == 2 ? (void (*)(void)) &brainfuck_scan_left_16 :
+					(void (*)(void)) &brainfuck_scan_left_32);
+			}
+			brainfuck_jit_emit(buffer, "\x48\x85\xC0", 3);   /* test rax, rax */
+			brainfuck_jit_emit_exit(buffer, "\x0F\x88",     /* js overrun/underrun */
+				op->code == BRAINFUCK_OP_SCAN_RIGHT ? BRAINFUCK_STATUS_OVERRUN : BRAINFUCK_STATUS_UNDERRUN);
+			brainfuck_jit_emit(buffer, "\x49\x8D\x5C", 3);   /* lea rbx, [r13 + rax * cell] */
+			brainfuck_jit_emit(buffer, &scale, 1);
+			brainfuck_jit_emit(buffer, "\x00", 1);
+			brainfuck_jit_patch(buffer, start, buffer->length);
+			if (probed)
+				brainfuck_jit_patch(buffer, probed, buffer->length);
+			break;
+		case BRAINFUCK_OP_MULTIPLY:
+			brainfuck_jit_emit_load(buffer);
+			brainfuck_jit_emit(buffer, "\x85\xC0", 2);       /* test eax, eax */
+			start = brainfuck_jit_emit_jump(buffer, "\x0F\x84", 2, 0); /* je done */
+			brainfuck_jit_emit(buffer, "\x48\x8D\x8B", 3);   /* lea rcx, [rbx + disp32] */
+			if (!brainfuck_jit_emit_cells(buffer, op->offset))
+				goto unsupported;
+			if (op->offset >= reach || -op->offset >= reach) {
+				brainfuck_jit_emit(buffer, "\x4C\x39\xF1", 3); /* cmp rcx, r14 */
+				brainfuck_jit_emit_exit(buffer, "\x0F\x83", BRAINFUCK_STATUS_OVERRUN); /* jae overrun */
+				brainfuck_jit_emit(buffer, "\x4C\x39\xE9", 3); /* cmp rcx, r13 */
+				brainfuck_jit_emit_exit(buffer, "\x0F\x82", BRAINFUCK_STATUS_UNDERRUN); /* jb underrun */
+			}
+			brainfuck_jit_emit(buffer, "\x69\xC0", 2);       /* imul eax, eax, imm32 */
+			brainfuck_jit_emit_int(buffer, op->argument);
+			brainfuck_jit_emit_cell(buffer, (char) 0x00, (char) 0x01); /* add [rcx], eax */
+			brainfuck_jit_emit(buffer, "\x01", 1);
+			brainfuck_jit_patch(buffer, start, buffer->length);
+			break;
+		case BRAINFUCK_OP_MOVE:
+			brainfuck_jit_emit(buffer, "\x48\x81\xC3", 3);   /* add rbx, imm32 */
+			if (!brainfuck_jit_emit_cells(buffer, op->argument))
+				goto unsupported;
+			break;
+		case BRAINFUCK_OP_CHECK:
+			if (op->argument < reach && -op->offset < reach)
+				break;
+			brainfuck_jit_emit(buffer, "\x48\x8D\x8B", 3);   /* lea rcx, [rbx + disp32] */
+			if (!brainfuck_jit_emit_cells(buffer, op->argument))
+				goto unsupported;
+			brainfuck_jit_emit(buffer, "\x4C\x39\xF1", 3);   /* cmp rcx, r14 */
+			brainfuck_jit_emit_exit(buffer, "\x0F\x83", BRAINFUCK_STATUS_OVERRUN); /* jae overrun */
+			brainfuck_jit_emit(buffer, "\x48\x8D\x8B", 3);   /* lea rcx, [rbx + disp32] */
+			if (!brainfuck_jit_emit_cells(buffer, op->offset))
+				goto unsupported;
+			brainfuck_jit_emit(buffer, "\x4C\x39\xE9", 3);   /* cmp rcx, r13 */
+			brainfuck_jit_emit_exit(buffer, "\x0F\x82", BRAINFUCK_STATUS_UNDERRUN); /* jb underrun */
+			break;
+		case BRAINFUCK_OP_COUNT:
+			brainfuck_jit_emit_load(buffer);
+			brainfuck_jit_emit(buffer, "\x89\xC7", 2);       /* mov edi, eax */
+			brainfuck_jit_emit(buffer, "\xBE", 1);           /* mov esi, imm32 */
+			brainfuck_jit_emit_int(buffer, op->argument);
+			brainfuck_jit_emit(buffer, "\xBA", 1);           /* mov edx, imm32 */
+			brainfuck_jit_emit_int(buffer, 8 * buffer->cell);
+			brainfuck_jit_emit_call(buffer, (void (*)(void)) &brainfuck_count);
+			brainfuck_jit_emit(buffer, "\x48\x85\xC0", 3);   /* test rax, rax */
+			done = brainfuck_jit_emit_jump(buffer, "\x0F\x89", 2, 0); /* jns store */
+			/* A loop that never terminates spins until execution is stopped or out of budget */
+			start = buffer->length;
+			brainfuck_jit_emit_back_edge(buffer, 1, start, stopped, exhausted);
+			brainfuck_jit_patch(buffer, done, buffer->length);
+			brainfuck_jit_emit_cell(buffer, (char) 0x88, (char) 0x89); /* mov [rbx], eax */
+			brainfuck_jit_emit_address(buffer, 0, 0);
+			break;
+		case BRAINFUCK_OP_END:
+			brainfuck_jit_emit_jump(buffer, "\xE9", 1, finish); /* jmp finish */
+			break;
+		default:
+			/* The debug extension is left to the interpreter */
+			goto unsupported;
+		}
+	}
+	brainfuck_jit_emit_stubs(buffer, leave);
+	free(loops);
+	free(ends);
+	free(positions);
+	free(buffer->exits);
+	return 1;
+unsupported:
+	/* Moves too far to address in 32 bits are left to the interpreter as well */
+	free(loops);
+	free(ends);
+	free(positions);
+	free(buffer->exits);
+	return 0;
+}
+
+#endif /* BRAINFUCK_JIT_X86_64 */
+
+/**
+ * Executes the given linked list containing instructions by translating it
+ * 	into machine code first. On platforms the just-in-time compiler does
+ * 	not support, the program is executed by the interpreter instead.
+ *
+ * @param root The start of the linked list of instructions you want
+ * 	to execute.
+ * @param context The context of this execution that contains the tape and
+ *	other execution related variables.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the program ran to its end,
+ * 	otherwise the <code>BRAINFUCK_STATUS_*</code> value that tells why it
+ * 	ended early.
+ */
+int brainfuck_execute_jit(BrainfuckInstruction *root, BrainfuckExecutionContext *context) {
+	int status;
+	if (root == NULL || context == NULL)
+		return BRAINFUCK_STATUS_OK;
+	if (context->guarded && (status = brainfuck_tape_check(context)) != BRAINFUCK_STATUS_OK)
+		return status;
+	BrainfuckProgram *program = brainfuck_compile(root);
+#ifdef BRAINFUCK_JIT_X86_64
+	BrainfuckJitBuffer buffer = { NULL, 0, 0, 0, NULL, 0, 0, { 0, 0 }, 0 };
+	BrainfuckTapeRecovery recovery;
+	size_t cell = (size_t) context->cell_width / 8;
+	void *code = MAP_FAILED;
+
+	buffer.cell = (int) cell;
+	if (brainfuck_jit_translate(program, &buffer, context->guarded))
+		code = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code != MAP_FAILED) {
+		/* The code is never writable and executable at the same time */
+		memcpy(code, buffer.code, buffer.length);
+		/* Security policies may forbid executable memory, in which case the program is interpreted */
+		if (mprotect(code, buffer.length, PROT_READ | PROT_EXEC) != 0) {
+			munmap(code, buffer.length);
+			code = MAP_FAILED;
+		}
+	}
+	free(buffer.code);
+	if (code == MAP_FAILED) {
+		status = brainfuck_execute_program(program, context);
+		brainfuck_destroy_program(program);
+		return status;
+	}
+	brainfuck_destroy_program(program);
+
+	BRAINFUCK_TAPE_RECOVER(context, recovery, status, end);
+	status = ((BrainfuckJitFunction) code)(context, context->tape + context->tape_index * cell,
+		context->tape, context->tape + context->tape_size * cell);
+	if (context->guarded)
+		brainfuck_tape_leave(context);
+	brainfuck_budget_settle(context);
+	/* The code leaves the pointer where it ran off the tape */
+	if (status == BRAINFUCK_STATUS_OVERRUN || status == BRAINFUCK_STATUS_UNDERRUN)
+		brainfuck_tape_fail(context, status);
+	else if (context->guarded && status == BRAINFUCK_STATUS_OK)
+		status = brainfuck_tape_check(context);
+	if (brainfuck_flush(context) != 0 && status == BRAINFUCK_STATUS_OK) {
+		context->position.line = 0;
+		context->position.column = 0;
+		status = BRAINFUCK_STATUS_IO;
+	}
+end:
+	munmap(code, buffer.length);
+	return status;
+#else
+	status = brainfuck_execute_program(program, context);
+	brainfuck_destroy_program(program);
+	return status;
+#endif
+}
@@ -26,21 +26,64 @@
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
     #include <io.h>
 	#define isatty _isatty
+	#define read _read
+	#define write _write
 	#define STDIN_FILENO 0
+	#define STDOUT_FILENO 1
 #else
 	#include <unistd.h>
 #endif
 
 #include <brainfuck.h>
 
+/* The optimization level to run programs at */
+static int optimization_level = BRAINFUCK_OPTIMIZE_DEFAULT;
+/* Whether programs are compiled into machine code before running them */
+static int use_jit = 0;
+/* Whether the tape is surrounded by guard pages instead of checking every move */
+static int use_guard = 0;
+/* Whether a large tape is reserved of which only touched pages use memory */
+static int use_sparse = 0;
+/* The width of the cells of the tape in bits */
+static int cell_width = 8;
+/* The path to write C code to instead of running programs */
+static char *emit_path = NULL;
+/* Whether to list the compiled operations of programs instead of running them */
+static int use_dump = 0;
+/* Whether to report the loops programs spend their time in after running them */
+static int use_profile = 0;
+/* The source of the program that is run, which the profile report shows loops of */
+static char *profile_source = NULL;
+/* The path to write the profile of programs to after running them */
+static char *profile_generate = NULL;
+/* The path to read a profile from that programs are compiled for */
+static char *profile_use = NULL;
+/* The amount of operations programs may execute, or a negative value for no limit */
+static long long fuel = -1;
+/* The time in milliseconds programs may run, or 0 for no limit */
+static long timeout = 0;
+
 /**
  * Print the usage message of this program.
  *
  * @param name The name of this program (given by argv[0]).
  */
 void print_usage(char *name) {
-	fprintf(stderr, "usage: %s [-evh] [file...]\n", name);
+	fprintf(stderr, "usage: %s [-evhjgs] [-O level] [-w width] [--emit-c out.c] [--dump] [--profile]\n"
+		"\t[--profile-generate out] [--profile-use in] [--fuel ops] [--timeout ms] [file...]\n", name);
 	fprintf(stderr, "\t-e --eval\t\trun code directly\n");
+	fprintf(stderr, "\t   --emit-c\t\twrite the program as C code instead of running it\n");
+	fprintf(stderr, "\t   --dump\t\tlist the compiled operations instead of running them\n");
+	fprintf(stderr, "\t   --profile\t\treport the loops the program spends its time in after running it\n");
+	fprintf(stderr, "\t   --profile-generate\twrite a profile of the run to a file\n");
+	fprintf(stderr, "\t   --profile-use\tcompile the program for a profile written earlier\n");
+	fprintf(stderr, "\t   --fuel\t\tstop programs after about this many operations\n");
+	fprintf(stderr, "\t   --timeout\t\tstop programs after this many milliseconds\n");
+	fprintf(stderr, "\t-j --jit\t\tcompile to machine code before running\n");
+	fprintf(stderr, "\t-g --guard\t\tcatch tape overruns with guard pages instead of checks\n");
+	fprintf(stderr, "\t-s --sparse\t\tuse a guarded tape of %d cells that starts in the middle\n", BRAINFUCK_SPARSE_TAPE_SIZE);
+	fprintf(stderr, "\t-w --cell-width\t\tset the width of the cells to 8, 16 or 32 bits (default 8)\n");
+	fprintf(stderr, "\t-O --optimize\t\tset the optimization level (default %d)\n", BRAINFUCK_OPTIMIZE_DEFAULT);
 	fprintf(stderr, "\t-v --version\t\tshow version information\n");
 	fprintf(stderr, "\t-h --help\t\tshow a help message\n");
 }
@@ -67,25 +110,275 @@ void initialize_readline() {
 #endif
 
 /**
- * Run the given brainfuck file.
+ * Write the given buffer to the standard output without going through stdio.
+ *
+ * @param buffer The bytes to write.
+ * @param length The amount of bytes to write.
+ * @return The amount of bytes that are written or a negative value on error.
+ */
+long write_stdout(const char *buffer, size_t length) {
+	return (long) write(STDOUT_FILENO, buffer, length);
+}
+
+/**
+ * Read from the standard input into the given buffer without going through stdio.
+ *
+ * @param buffer The buffer to read into.
+ * @param length The amount of bytes the buffer has room for.
+ * @return The amount of bytes that are read, 0 at the end of the input or a
+ * 	negative value on error.
+ */
+long read_stdin(char *buffer, size_t length) {
+	return (long) read(STDIN_FILENO, buffer, length);
+}
+
+/**
+ * Create a context for running programs that reads the input and writes the
+ * 	output of the program in blocks from the standard input and to the
+ * 	standard output.
+ *
+ * @return The context that is created.
+ */
+BrainfuckExecutionContext * create_context() {
+	BrainfuckExecutionContext *context = use_sparse ? brainfuck_sparse_context(-1) :
+		use_guard ? brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE) : brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	brainfuck_set_cell_width(context, cell_width);
+	context->write_handler = &write_stdout;
+	context->read_handler = &read_stdin;
+	context->fuel = fuel;
+	brainfuck_set_timeout(context, timeout);
+	return context;
+}
+
+/**
+ * Write the instructions of the given state as C code to the file at the path
+ * 	given by the --emit-c option.
  *
- * @param file The brainfuck file to run.
+ * @param state The state containing the instructions to write.
  * @return EXIT_SUCCESS if no errors are encountered, otherwise EXIT_FAILURE.
  */
-int run_file(FILE *file) {
-	BrainfuckState *state = brainfuck_state();
-	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
-	if (file == NULL) {
-		brainfuck_destroy_context(context);
-		brainfuck_destroy_state(state);
+int emit_state(BrainfuckState *state) {
+	FILE *out = fopen(emit_path, "w");
+	if (out == NULL) {
+		fprintf(stderr, "error: failed to open file %s\n", emit_path);
+		return EXIT_FAILURE;
+	}
+	if (brainfuck_emit_c(state->root, out) != 0 || fclose(out) != 0) {
+		fprintf(stderr, "error: failed to write file %s\n", emit_path);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * List the compiled operations of the given state on the standard output.
+ *
+ * @param state The state containing the instructions to list.
+ */
+void dump_state(BrainfuckState *state) {
+	BrainfuckProgram *program = brainfuck_compile(state->root);
+	brainfuck_dump_program(program, stdout);
+	brainfuck_destroy_program(program);
+}
+
+/**
+ * Apply the profile at the path given by the --profile-use option to the
+ * 	instructions of the given state.
+ *
+ * @param state The state containing the instructions to apply the profile to.
+ * @return EXIT_SUCCESS if no errors are encountered, otherwise EXIT_FAILURE.
+ */
+int apply_profile(BrainfuckState *state) {
+	FILE *in = fopen(profile_use, "r");
+	int result;
+	if (in == NULL) {
+		fprintf(stderr, "error: failed to open file %s\n", profile_use);
+		return EXIT_FAILURE;
+	}
+	result = brainfuck_profile_apply(state->root, in);
+	fclose(in);
+	if (result != 0) {
+		fprintf(stderr, "error: malformed profile %s\n", profile_use);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Write the profile of the given profiled program to the file at the path
+ * 	given by the --profile-generate option.
+ *
+ * @param program The program that is profiled.
+ * @return EXIT_SUCCESS if no errors are encountered, otherwise EXIT_FAILURE.
+ */
+int write_profile(BrainfuckProgram *program) {
+	FILE *out = fopen(profile_generate, "w");
+	if (out == NULL) {
+		fprintf(stderr, "error: failed to open file %s\n", profile_generate);
+		return EXIT_FAILURE;
+	}
+	if (brainfuck_profile_write(program, out) != 0 || fclose(out) != 0) {
+		fprintf(stderr, "error: failed to write file %s\n", profile_generate);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Report the unmatched bracket that made parsing into the given arena fail.
+ *
+ * @param arena The arena the program was parsed into.
+ * @return <code>1</code> if a bracket was unmatched, otherwise <code>0</code>.
+ */
+int report_parse_error(BrainfuckArena *arena) {
+	if (arena->unmatched == 0)
+		return 0;
+	fprintf(stderr, "error: unmatched '%c' at line %d, column %d\n", arena->unmatched,
+		arena->unmatched_position.line, arena->unmatched_position.column);
+	return 1;
+}
+
+/**
+ * Report how the execution of a program in the given context ended.
+ *
+ * @param context The context the program ran in.
+ * @param status The status the execution ended with.
+ * @return EXIT_SUCCESS if the program ran to its end, otherwise EXIT_FAILURE.
+ */
+int report_status(BrainfuckExecutionContext *context, int status) {
+	switch (status) {
+	case BRAINFUCK_STATUS_OK:
+		return EXIT_SUCCESS;
+	case BRAINFUCK_STATUS_BUDGET:
+		if (context->fuel == 0)
+			fprintf(stderr, "error: program ran out of its fuel of %lld operations\n", fuel);
+		else
+			fprintf(stderr, "error: program exceeded the time limit of %ld ms\n", timeout);
+		return EXIT_FAILURE;
+	case BRAINFUCK_STATUS_OVERRUN:
+		fprintf(stderr, "error: tape memory out of bounds (overrun)\nexceeded the tape size of %zd cells\n", context->tape_size);
+		break;
+	case BRAINFUCK_STATUS_UNDERRUN:
+		fprintf(stderr, "error: tape memory out of bounds (underrun)\nundershot the tape size of %zd cells\n", context->tape_size);
+		break;
+	case BRAINFUCK_STATUS_IO:
+		fprintf(stderr, "error: failed to read input or write output\n");
+		break;
+	default:
+		fprintf(stderr, "error: program is stopped\n");
 		return EXIT_FAILURE;
 	}
-	brainfuck_add(state, brainfuck_parse_stream(file));
-	brainfuck_execute(state->root, context);
+	if (context->position.line > 0)
+		fprintf(stderr, "at line %d, column %d\n", context->position.line, context->position.column);
+	return EXIT_FAILURE;
+}
+
+/**
+ * Run the instructions of the given state.
+ *
+ * @param state The state containing the instructions to run.
+ * @param context The context to run the instructions in.
+ * @return EXIT_SUCCESS if no errors are encountered, otherwise EXIT_FAILURE.
+ */
+int run_state(BrainfuckState *state, BrainfuckExecutionContext *context) {
+	BrainfuckProgram *program;
+	int result, status;
+	if (use_profile || profile_generate != NULL) {
+		/* Only the interpreter of compiled programs counts operations */
+		program = brainfuck_compile(state->root);
+		status = brainfuck_profile_program(program, context);
+		result = report_status(context, status);
+		if (use_profile)
+			brainfuck_profile_report(program, profile_source, 10, stderr);
+		if (profile_generate != NULL && write_profile(program) != EXIT_SUCCESS)
+			result = EXIT_FAILURE;
+		brainfuck_destroy_program(program);
+		return result;
+	}
+	if (use_jit)
+		return report_status(context, brainfuck_execute_jit(state->root, context));
+	program = brainfuck_compile(state->root);
+	status = brainfuck_execute_program(program, context);
+	brainfuck_destroy_program(program);
+	return report_status(context, status);
+}
+
+/**
+ * Run the instructions of the given state, or write them as C code if requested.
+ *
+ * @param state The state containing the instructions to run, which is
+ * 	destroyed afterwards.
+ * @return EXIT_SUCCESS if no errors are encountered, otherwise EXIT_FAILURE.
+ */
+int run_instructions(BrainfuckState *state) {
+	BrainfuckExecutionContext *context = create_context();
+	int result = EXIT_SUCCESS;
+	/* The C code does not depend on how scans are compiled, so it ignores profiles */
+	if (profile_use != NULL && emit_path == NULL && apply_profile(state) != EXIT_SUCCESS)
+		result = EXIT_FAILURE;
+	else if (emit_path != NULL)
+		result = emit_state(state);
+	else if (use_dump)
+		dump_state(state);
+	else
+		result = run_state(state, context);
 	brainfuck_destroy_context(context);
 	brainfuck_destroy_state(state);
+	return result;
+}
+
+/**
+ * Read the file at the given path into memory, so the profile report can show
+ * 	the source of its loops.
+ *
+ * @param path The path to the file to read.
+ * @return The contents of the file, which should be freed by the caller, or
+ * 	NULL if the file cannot be read.
+ */
+char * read_source(char *path) {
+	FILE *file = fopen(path, "rb");
+	size_t length = 0, capacity = 4096, count;
+	char *source;
+	if (file == NULL)
+		return NULL;
+	source = (char *) malloc(capacity);
+	while ((count = fread(source + length, 1, capacity - length - 1, file)) > 0) {
+		length += count;
+		if (length == capacity - 1) {
+			capacity *= 2;
+			source = (char *) realloc(source, capacity);
+		}
+	}
 	fclose(file);
-	return EXIT_SUCCESS;
+	source[length] = '\0';
+	return source;
+}
+
+/**
+ * Run the brainfuck file at the given path.
+ *
+ * @param path The path to the brainfuck file to run or NULL to read the
+ * 	program from stdin.
+ * @return EXIT_SUCCESS if no errors are encountered, otherwise EXIT_FAILURE.
+ */
+int run_file(char *path) {
+	int result;
+	BrainfuckState *state = brainfuck_state();
+	BrainfuckInstruction *instruction = path != NULL ? brainfuck_arena_parse_file(state->arena, path) :
+		brainfuck_arena_parse_stream(state->arena, stdin);
+	if (instruction == NULL) {
+		if (!report_parse_error(state->arena))
+			fprintf(stderr, "error: failed to load %s\n", path != NULL ? path : "program from stdin");
+		brainfuck_destroy_state(state);
+		return EXIT_FAILURE;
+	}
+	brainfuck_add(state, brainfuck_optimize(instruction, optimization_level));
+	if (use_profile && path != NULL)
+		profile_source = read_source(path);
+	result = run_instructions(state);
+	free(profile_source);
+	profile_source = NULL;
+	return result;
 }
 
 /**
@@ -95,14 +388,19 @@ int run_file(FILE *file) {
  * @return EXIT_SUCCESS if no errors are encountered, otherwise EXIT_FAILURE.
  */
 int run_string(char *code) {
+	int result;
 	BrainfuckState *state = brainfuck_state();
-	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
-	BrainfuckInstruction *instruction = brainfuck_parse_string(code);
-	brainfuck_add(state, instruction);
-	brainfuck_execute(state->root, context);
-	brainfuck_destroy_context(context);
-	brainfuck_destroy_state(state);
-	return EXIT_SUCCESS;
+	BrainfuckInstruction *instruction = brainfuck_arena_parse_string(state->arena, code);
+	if (instruction == NULL) {
+		report_parse_error(state->arena);
+		brainfuck_destroy_state(state);
+		return EXIT_FAILURE;
+	}
+	brainfuck_add(state, brainfuck_optimize(instruction, optimization_level));
+	profile_source = code;
+	result = run_instructions(state);
+	profile_source = NULL;
+	return result;
 }
 
 /**
@@ -117,6 +415,7 @@ void run_interactive_console() {
 	BrainfuckState *state = brainfuck_state();
 	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
 	BrainfuckInstruction *instruction;
+	brainfuck_set_cell_width(context, cell_width);
 #ifdef BRAINFUCK_EDITLINE_LIB
 	char *line;
 
@@ -140,20 +439,22 @@ void run_interactive_console() {
 			/* EOF */
 			break;
 		}
-		instruction = brainfuck_parse_string(line);
+		instruction = brainfuck_arena_parse_string(state->arena, line);
 		free(line);
+		report_parse_error(state->arena);
 		brainfuck_add(state, instruction);
-		brainfuck_execute(instruction, context);
+		report_status(context, brainfuck_execute(instruction, context));
 	}
 #else
 	printf(">> ");
 	while(1) {
 		fflush(stdout);
-		instruction = brainfuck_parse_stream_until(stdin, '\n');
+		instruction = brainfuck_arena_parse_stream_until(state->arena, stdin, '\n');
 		if (feof(stdin)) { break; }
 		fflush(stdin);
+		report_parse_error(state->arena);
 		brainfuck_add(state, instruction);
-		brainfuck_execute(instruction, context);
+		report_status(context, brainfuck_execute(instruction, context));
 		printf(">> ");
 	}
 #endif
@@ -163,6 +464,18 @@ void run_interactive_console() {
 static struct option long_options[] = {
 	{"help", no_argument, 0, 'h'},
 	{"eval", required_argument, 0, 'e'},
+	{"optimize", required_argument, 0, 'O'},
+	{"jit", no_argument, 0, 'j'},
+	{"guard", no_argument, 0, 'g'},
+	{"sparse", no_argument, 0, 's'},
+	{"cell-width", required_argument, 0, 'w'},
+	{"emit-c", required_argument, 0, 'C'},
+	{"dump", no_argument, &use_dump, 1},
+	{"profile", no_argument, &use_profile, 1},
+	{"profile-generate", required_argument, 0, 'G'},
+	{"profile-use", required_argument, 0, 'U'},
+	{"fuel", required_argument, 0, 'F'},
+	{"timeout", required_argument, 0, 'T'},
 	{"version", no_argument, 0, 'v'},
 	{0, 0, 0, 0}
 };
@@ -175,12 +488,13 @@ static struct option long_options[] = {
  */
 int main(int argc, char *argv[]) {
 	int c;
-	int i = 1;
+	int i;
 	int option_index = 0;
+	int result = EXIT_SUCCESS;
 
 	while (1) {
 		option_index = 0;
-		c = getopt_long (argc, argv, "vhe:",
+		c = getopt_long (argc, argv, "vhjgse:O:w:",
 			long_options, &option_index);
 		if (c == -1)
 			break;
@@ -198,6 +512,40 @@ int main(int argc, char *argv[]) {
 			return EXIT_SUCCESS;
 		case 'e':
 			return run_string((char *) optarg);
+		case 'O':
+			optimization_level = atoi(optarg);
+			break;
+		case 'j':
+			use_jit = 1;
+			break;
+		case 'g':
+			use_guard = 1;
+			break;
+		case 's':
+			use_sparse = 1;
+			break;
+		case 'w':
+			cell_width = atoi(optarg);
+			if (cell_width != 8 && cell_width != 16 && cell_width != 32) {
+				fprintf(stderr, "error: unsupported cell width %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'C':
+			emit_path = optarg;
+			break;
+		case 'G':
+			profile_generate = optarg;
+			break;
+		case 'U':
+			profile_use = optarg;
+			break;
+		case 'F':
+			fuel = atoll(optarg);
+			break;
+		case 'T':
+			timeout = atol(optarg);
+			break;
 		case '?':
 			print_usage(argv[0]);
 			return EXIT_FAILURE;
@@ -205,18 +553,30 @@ int main(int argc, char *argv[]) {
 			abort();
 		}
 	}
-	if (argc > 1) {
-		while (i < argc)
-			if (run_file(fopen(argv[i++], "r")) == EXIT_FAILURE)
-				fprintf(stderr, "error: failed to read file %s\n", argv[i - 1]);
+	i = optind;
+	if (emit_path != NULL) {
+		if (argc - i > 1) {
+			fprintf(stderr, "error: --emit-c accepts a single file\n");
+			return EXIT_FAILURE;
+		}
+		if (cell_width != 8) {
+			fprintf(stderr, "error: --emit-c only supports 8-bit cells\n");
+			return EXIT_FAILURE;
+		}
+		return run_file(i < argc ? argv[i] : NULL);
+	}
+	if (i < argc) {
+		while (i < argc) {
+			if (run_file(argv[i++]) != EXIT_SUCCESS)
+				result = EXIT_FAILURE;
+		}
 	} else {
 		/* Check if someone is piping code or just calling it the normal way */
-		if (isatty(STDIN_FILENO)) {
+		if (isatty(STDIN_FILENO) && !use_dump) {
 			run_interactive_console();
 		} else {
-			if (run_file(stdin) == EXIT_FAILURE)
-				fprintf(stderr, "error: failed to read from stdin\n");
+			result = run_file(NULL);
 		}
 	}
-	return EXIT_SUCCESS;
+	return result;
 }
@@ -0,0 +1,714 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <brainfuck.h>
+
+/* The maximum amount of instructions in a loop body that is rewritten */
+#define BRAINFUCK_IDIOM_MAX 64
+/* The maximum amount of cells whose values are tracked at once */
+#define BRAINFUCK_FLOW_MAX 64
+
+/**
+ * Collects the loops and branches in the given linked list of instructions,
+ * 	ordered such that every loop comes after all loops that are nested in
+ * 	it. The tree is walked without recursion, so deeply nested loops are no
+ * 	problem.
+ *
+ * @param root The start of the linked list of instructions.
+ * @param count A pointer to the integer that will hold the amount of loops.
+ * @return An array containing the loops, which should be freed by the caller.
+ */
+static BrainfuckInstruction ** brainfuck_collect_loops(BrainfuckInstruction *root, size_t *count) {
+	BrainfuckInstruction **loops = NULL, **stack = NULL, *iter;
+	size_t size = 0, depth = 0, capacity = 0, i;
+
+	*count = 0;
+	if (root == NULL)
+		return NULL;
+	stack = (BrainfuckInstruction **) malloc(16 * sizeof(BrainfuckInstruction *));
+	capacity = 16;
+	stack[depth++] = root;
+	while (depth > 0) {
+		for (iter = stack[--depth]; iter != NULL && iter->type != BRAINFUCK_TOKEN_LOOP_END; iter = iter->next) {
+			if (iter->type != BRAINFUCK_TOKEN_LOOP_START && iter->type != BRAINFUCK_TOKEN_IF)
+				continue;
+			if (*count == size) {
+				size = size ? size * 2 : 16;
+				loops = (BrainfuckInstruction **) realloc(loops, size * sizeof(BrainfuckInstruction *));
+			}
+			loops[(*count)++] = iter;
+			if (iter->loop == NULL)
+				continue;
+			if (depth == capacity) {
+				capacity *= 2;
+				stack = (BrainfuckInstruction **) realloc(stack, capacity * sizeof(BrainfuckInstruction *));
+			}
+			stack[depth++] = iter->loop;
+		}
+	}
+	free(stack);
+
+	/* Every loop was collected before the loops nested in it, so reverse the order */
+	for (i = 0; i < *count / 2; i++) {
+		iter = loops[i];
+		loops[i] = loops[*count - i - 1];
+		loops[*count - i - 1] = iter;
+	}
+	return loops;
+}
+
+/**
+ * Inserts an instruction taken from the given list of spare instructions after
+ * 	the given instruction. Reusing the instructions of a discarded loop body
+ * 	keeps them allocated the same way (and from the same arena) as the rest
+ * 	of the program.
+ *
+ * @param after The instruction to insert the new instruction after.
+ * @param spare A pointer to the list of spare instructions, which must not be empty.
+ * @param type The type of the new instruction.
+ * @param difference The difference of the new instruction.
+ * @param offset The offset of the new instruction.
+ * @return The instruction that is inserted.
+ */
+static BrainfuckInstruction * brainfuck_append(BrainfuckInstruction *after, BrainfuckInstruction **spare,
+		char type, int difference, int offset) {
+	BrainfuckInstruction *instruction = *spare;
+	assert(instruction != NULL);
+	*spare = instruction->next;
+	instruction->type = type;
+	instruction->difference = difference;
+	instruction->offset = offset;
+	instruction->loop = 0;
+	instruction->position = after->position;
+	instruction->previous = after;
+	instruction->next = after->next;
+	if (after->next != NULL)
+		after->next->previous = instruction;
+	after->next = instruction;
+	return instruction;
+}
+
+/**
+ * Turns the given loop into a plain instruction, discarding its body.
+ *
+ * @param loop The loop to turn into an instruction.
+ * @param type The type of the instruction.
+ * @param difference The difference of the instruction.
+ * @param offset The offset of the instruction.
+ */
+static void brainfuck_replace_loop(BrainfuckInstruction *loop, char type, int difference, int offset) {
+	brainfuck_destroy_instructions(loop->loop);
+	loop->loop = 0;
+	loop->type = type;
+	loop->difference = difference;
+	loop->offset = offset;
+}
+
+/**
+ * Rewrites the given loop if its body consists of a common idiom:
+ * <ul>
+ * 	<li><code>[-]</code> clears the cell and becomes a set instruction.</li>
+ * 	<li><code>[>]</code> moves to the next zero cell and becomes a scan instruction.</li>
+ * 	<li><code>[->+>++<<]</code> adds multiples of the cell to other cells and
+ * 		becomes a series of multiply instructions followed by a set instruction.</li>
+ * 	<li><code>[--->+<]</code> does the same with a step other than one, so the
+ * 		multiply instructions are preceded by a count instruction that replaces
+ * 		the cell by the amount of iterations the loop runs.</li>
+ * </ul>
+ *
+ * @param loop The loop to rewrite.
+ */
+static void brainfuck_rewrite_idiom(BrainfuckInstruction *loop) {
+	BrainfuckInstruction *iter, *tail, *spare;
+	int offsets[BRAINFUCK_IDIOM_MAX], deltas[BRAINFUCK_IDIOM_MAX];
+	int count = 0, length = 0, offset = 0, low = 0, high = 0, step = 0;
+	int covered_low = 0, covered_high = 0, adds = 0, i;
+
+	for (iter = loop->loop; iter != NULL && iter->type != BRAINFUCK_TOKEN_LOOP_END; iter = iter->next) {
+		if (++length > BRAINFUCK_IDIOM_MAX)
+			return;
+		switch (iter->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+		case BRAINFUCK_TOKEN_MINUS:
+			for (i = 0; i < count && offsets[i] != offset; i++) { }
+			if (i == count) {
+				offsets[count] = offset;
+				deltas[count++] = 0;
+			}
+			deltas[i] += iter->type == BRAINFUCK_TOKEN_PLUS ? iter->difference : -iter->difference;
+			adds++;
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+			offset += iter->difference;
+			break;
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			offset -= iter->difference;
+			break;
+		default:
+			return;
+		}
+		if (offset < low) low = offset;
+		if (offset > high) high = offset;
+	}
+
+	/* [>] and [<] and their strided variants */
+	if (adds == 0) {
+		if (offset != 0 && low >= (offset < 0 ? offset : 0) && high <= (offset > 0 ? offset : 0))
+			brainfuck_replace_loop(loop, BRAINFUCK_TOKEN_SCAN, offset, 0);
+		return;
+	}
+
+	/* The remaining idioms have to end at the cell they started at */
+	if (offset != 0)
+		return;
+	for (i = 0; i < count; i++) {
+		if (offsets[i] == 0) {
+			step = deltas[i];
+		} else if (deltas[i] != 0) {
+			if (offsets[i] < covered_low) covered_low = offsets[i];
+			if (offsets[i] > covered_high) covered_high = offsets[i];
+		}
+	}
+
+	/* [-] and [+], where any odd step will eventually reach zero */
+	if (low == 0 && high == 0 && count == 1 && step % 2 != 0) {
+		brainfuck_replace_loop(loop, BRAINFUCK_TOKEN_SET, 0, 0);
+		return;
+	}
+
+	/*
+	 * [->+<] and friends, which only qualify if all the cells the pointer visits
+	 * are changed, so a tape overrun is reported for the same programs.
+	 */
+	if (step == 0 || low < covered_low || high > covered_high)
+		return;
+	/*
+	 * The body has an instruction for every changed cell and one to end it, so
+	 * it has enough instructions to become the count, multiply and set
+	 * instructions.
+	 */
+	spare = loop->loop;
+	loop->loop = 0;
+	tail = NULL;
+	if (step != 1 && step != -1) {
+		/* Every iteration adds the deltas once, so they are multiplied by the count */
+		brainfuck_replace_loop(loop, BRAINFUCK_TOKEN_COUNT, step, 0);
+		tail = loop;
+		step = -1;
+	}
+	for (i = 0; i < count; i++) {
+		if (offsets[i] == 0 || deltas[i] == 0)
+			continue;
+		if (tail == NULL) {
+			brainfuck_replace_loop(loop, BRAINFUCK_TOKEN_MULTIPLY, -step * deltas[i], offsets[i]);
+			tail = loop;
+		} else {
+			tail = brainfuck_append(tail, &spare, BRAINFUCK_TOKEN_MULTIPLY, -step * deltas[i], offsets[i]);
+		}
+	}
+	if (tail == NULL)
+		brainfuck_replace_loop(loop, BRAINFUCK_TOKEN_SET, 0, 0);
+	else
+		brainfuck_append(tail, &spare, BRAINFUCK_TOKEN_SET, 0, 0);
+	brainfuck_destroy_instructions(spare);
+}
+
+/**
+ * Turns the given loop into a branch if it provably runs at most once, because
+ * 	its body leaves the pointer at a cell that is zero, like
+ * 	<code>[>+<[-]]</code> and loops that end with a nested loop.
+ *
+ * @param loop The loop to rewrite.
+ */
+static void brainfuck_rewrite_branch(BrainfuckInstruction *loop) {
+	BrainfuckInstruction *iter;
+	/* The position of a cell that is known to be zero relative to the pointer */
+	long zero = 0;
+	int known = 0;
+
+	for (iter = loop->loop; iter != NULL && iter->type != BRAINFUCK_TOKEN_LOOP_END; iter = iter->next) {
+		switch (iter->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+		case BRAINFUCK_TOKEN_MINUS:
+			if (zero == 0 && iter->difference != 0)
+				known = 0;
+			break;
+		case BRAINFUCK_TOKEN_INPUT:
+		case BRAINFUCK_TOKEN_COUNT:
+			if (zero == 0)
+				known = 0;
+			break;
+		case BRAINFUCK_TOKEN_SET:
+			if (iter->difference == 0) {
+				known = 1;
+				zero = 0;
+			} else if (zero == 0) {
+				known = 0;
+			}
+			break;
+		case BRAINFUCK_TOKEN_MULTIPLY:
+			if (zero == iter->offset)
+				known = 0;
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+			zero -= iter->difference;
+			break;
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			zero += iter->difference;
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+		case BRAINFUCK_TOKEN_SCAN:
+			/* These end at a zero cell, wherever that is */
+			known = 1;
+			zero = 0;
+			break;
+		case BRAINFUCK_TOKEN_OUTPUT:
+		case BRAINFUCK_TOKEN_BREAK:
+			break;
+		default:
+			return;
+		}
+	}
+	if (known && zero == 0)
+		loop->type = BRAINFUCK_TOKEN_IF;
+}
+
+/**
+ * A cell whose value the dataflow analysis keeps track of.
+ */
+typedef struct BrainfuckCell {
+	/* The position of the cell relative to the start of the analyzed list */
+	long offset;
+	/* Whether the value of the cell is known */
+	int known;
+	/* The exact value of the cell, which only wraps when it is stored */
+	long value;
+	/* The last instruction that stored into the cell without the cell being read since */
+	BrainfuckInstruction *store;
+} BrainfuckCell;
+
+/**
+ * The state of the dataflow analysis at some point in a list of instructions.
+ */
+typedef struct BrainfuckFlow {
+	BrainfuckCell cells[BRAINFUCK_FLOW_MAX];
+	int count;
+	/* Whether the cells that are not tracked are known to be zero */
+	int zero;
+	/* The position of the pointer relative to the start of the analyzed list */
+	long position;
+	/* The range of cells that accesses showed to lie on the tape, since it has no holes */
+	long low, high;
+} BrainfuckFlow;
+
+/**
+ * Forgets everything about the cells, except that the current cell may be
+ * 	known to be zero. The pointer position becomes the new origin.
+ *
+ * @param flow The state of the analysis.
+ * @param zero Whether the current cell is known to be zero.
+ */
+static void brainfuck_flow_reset(BrainfuckFlow *flow, int zero) {
+	flow->count = 0;
+	flow->zero = 0;
+	flow->position = 0;
+	flow->low = 0;
+	flow->high = 0;
+	if (zero) {
+		flow->cells[0].offset = 0;
+		flow->cells[0].known = 1;
+		flow->cells[0].value = 0;
+		flow->cells[0].store = NULL;
+		flow->count = 1;
+	}
+}
+
+/**
+ * Finds the given cell, starting to track it if it is not tracked yet. When
+ * 	too many cells are tracked, the others are forgotten.
+ *
+ * @param flow The state of the analysis.
+ * @param offset The position of the cell.
+ * @return The cell that is tracked.
+ */
+static BrainfuckCell * brainfuck_flow_cell(BrainfuckFlow *flow, long offset) {
+	BrainfuckCell *cell;
+	int i;
+	for (i = 0; i < flow->count; i++) {
+		if (flow->cells[i].offset == offset)
+			return &flow->cells[i];
+	}
+	if (flow->count == BRAINFUCK_FLOW_MAX) {
+		flow->count = 0;
+		flow->zero = 0;
+	}
+	cell = &flow->cells[flow->count++];
+	cell->offset = offset;
+	cell->known = flow->zero;
+	cell->value = 0;
+	cell->store = NULL;
+	return cell;
+}
+
+/**
+ * Records an access of the cell at the given position, which the executors
+ * 	check, so that the access shows the cell to lie on the tape.
+ *
+ * @param flow The state of the analysis.
+ * @param offset The position of the cell.
+ * @return <code>1</code> if an earlier access already showed the cell to lie
+ * 	on the tape, in which case the access may be removed, otherwise
+ * 	<code>0</code>, since removing it hides the program leaving the tape.
+ */
+static int brainfuck_flow_access(BrainfuckFlow *flow, long offset) {
+	if (offset >= flow->low && offset <= flow->high)
+		return 1;
+	if (offset < flow->low)
+		flow->low = offset;
+	else
+		flow->high = offset;
+	return 0;
+}
+
+/**
+ * Marks all cells as read, so none of the stores into them can be removed.
+ *
+ * @param flow The state of the analysis.
+ */
+static void brainfuck_flow_read(BrainfuckFlow *flow) {
+	int i;
+	for (i = 0; i < flow->count; i++)
+		flow->cells[i].store = NULL;
+}
+
+/**
+ * Determines which cells the given loop or branch may change, relative to
+ * 	the pointer at its start.
+ *
+ * @param loop The loop to inspect.
+ * @param low A pointer to the long that will hold the lowest changed cell.
+ * @param high A pointer to the long that will hold the highest changed cell,
+ * 	which is lower than the lowest if no cell is changed.
+ * @return <code>1</code> if every pass through the loop and its nested loops
+ * 	leaves the pointer where it started, otherwise <code>0</code>.
+ */
+static int brainfuck_flow_writes(BrainfuckInstruction *loop, long *low, long *high) {
+	BrainfuckInstruction *iter, **stack = NULL;
+	long offset = 0, *offsets = NULL, changed;
+	size_t depth = 0, capacity = 0;
+	int result = 1;
+
+	*low = 1;
+	*high = 0;
+	iter = loop->loop;
+	while (result) {
+		if (iter == NULL || iter->type == BRAINFUCK_TOKEN_LOOP_END) {
+			if (depth == 0)
+				break;
+			depth--;
+			if (offset != offsets[depth]) {
+				result = 0;
+				break;
+			}
+			iter = stack[depth]->next;
+			continue;
+		}
+		changed = 0;
+		switch (iter->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+		case BRAINFUCK_TOKEN_MINUS:
+		case BRAINFUCK_TOKEN_SET:
+		case BRAINFUCK_TOKEN_INPUT:
+		case BRAINFUCK_TOKEN_COUNT:
+			changed = 1;
+			break;
+		case BRAINFUCK_TOKEN_MULTIPLY:
+			changed = 1;
+			offset += iter->offset;
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+			offset += iter->difference;
+			break;
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			offset -= iter->difference;
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+			if (depth == capacity) {
+				capacity = capacity ? capacity * 2 : 16;
+				stack = (BrainfuckInstruction **) realloc(stack, capacity * sizeof(BrainfuckInstruction *));
+				offsets = (long *) realloc(offsets, capacity * sizeof(long));
+			}
+			stack[depth] = iter;
+			offsets[depth++] = offset;
+			iter = iter->loop;
+			continue;
+		case BRAINFUCK_TOKEN_OUTPUT:
+		case BRAINFUCK_TOKEN_BREAK:
+			break;
+		default:
+			result = 0;
+			break;
+		}
+		if (changed) {
+			if (*low > *high) {
+				*low = *high = offset;
+			} else {
+				if (offset < *low) *low = offset;
+				if (offset > *high) *high = offset;
+			}
+			if (iter->type == BRAINFUCK_TOKEN_MULTIPLY)
+				offset -= iter->offset;
+		}
+		iter = iter->next;
+	}
+	free(stack);
+	free(offsets);
+	return result && offset == 0;
+}
+
+/**
+ * Updates the state of the analysis for a loop or branch that may run, after
+ * 	which the current cell is zero.
+ *
+ * @param flow The state of the analysis.
+ * @param loop The loop that may run.
+ */
+static void brainfuck_flow_loop(BrainfuckFlow *flow, BrainfuckInstruction *loop) {
+	long low, high, offset;
+	int i;
+
+	/* The loop may read any cell */
+	brainfuck_flow_read(flow);
+	if (!brainfuck_flow_writes(loop, &low, &high)) {
+		brainfuck_flow_reset(flow, 1);
+		return;
+	}
+	if (low <= high) {
+		low += flow->position;
+		high += flow->position;
+		for (i = 0; i < flow->count; i++) {
+			if (flow->cells[i].offset >= low && flow->cells[i].offset <= high)
+				flow->cells[i].known = 0;
+		}
+		/* Cells that are not tracked yet are no longer zero after the loop */
+		if (flow->zero) {
+			if (high - low < BRAINFUCK_FLOW_MAX - flow->count) {
+				for (offset = low; offset <= high; offset++)
+					brainfuck_flow_cell(flow, offset)->known = 0;
+			} else {
+				flow->zero = 0;
+			}
+		}
+	}
+	brainfuck_flow_cell(flow, flow->position)->known = 1;
+	brainfuck_flow_cell(flow, flow->position)->value = 0;
+}
+
+/**
+ * Unlinks the given instruction from its list and destroys it.
+ *
+ * @param first A pointer to the first instruction of the list.
+ * @param instruction The instruction to remove.
+ */
+static void brainfuck_unlink(BrainfuckInstruction **first, BrainfuckInstruction *instruction) {
+	if (instruction->previous != NULL)
+		instruction->previous->next = instruction->next;
+	else
+		*first = instruction->next;
+	if (instruction->next != NULL)
+		instruction->next->previous = instruction->previous;
+	instruction->next = NULL;
+	brainfuck_destroy_instructions(instruction);
+}
+
+/**
+ * Stores a known value into the given cell with the given set instruction,
+ * 	removing the previous store into the cell if it was never read.
+ *
+ * @param first A pointer to the first instruction of the list.
+ * @param cell The cell to store into.
+ * @param instruction The set instruction that stores the value.
+ * @param removable Whether the store may be removed later, which it may not
+ * 	if it is the access that shows the cell to lie on the tape.
+ */
+static void brainfuck_flow_store(BrainfuckInstruction **first, BrainfuckCell *cell,
+		BrainfuckInstruction *instruction, int removable) {
+	if (cell->store != NULL)
+		brainfuck_unlink(first, cell->store);
+	cell->known = 1;
+	cell->value = instruction->difference;
+	cell->store = removable ? instruction : NULL;
+}
+
+/**
+ * Propagates known cell values through the given list of instructions, not
+ * 	including the bodies of its loops:
+ * <ul>
+ * 	<li>Loops and branches at a cell that is known to be zero are removed.</li>
+ * 	<li>Additions to a cell with a known value become set instructions, and
+ * 		stores of the value a cell already has are removed.</li>
+ * 	<li>Stores into a cell that is overwritten before it is read are removed.</li>
+ * </ul>
+ * Only accesses of cells that earlier accesses showed to lie on the tape are
+ * 	removed, since the executors report leaving the tape at the access.
+ *
+ * @param first The first instruction of the list.
+ * @param zero Whether all cells are known to be zero at the start of the list.
+ * @return The first instruction of the list after the analysis.
+ */
+static BrainfuckInstruction * brainfuck_propagate(BrainfuckInstruction *first, int zero) {
+	BrainfuckInstruction *iter, *next;
+	BrainfuckFlow flow;
+	BrainfuckCell *cell, *target;
+	long value;
+	/* Whether the cell of the instruction is known to lie on the tape */
+	int inside;
+
+	brainfuck_flow_reset(&flow, 0);
+	flow.zero = zero;
+	for (iter = first; iter != NULL && iter->type != BRAINFUCK_TOKEN_LOOP_END; iter = next) {
+		next = iter->next;
+		switch (iter->type) {
+		case BRAINFUCK_TOKEN_PLUS:
+		case BRAINFUCK_TOKEN_MINUS:
+			if (iter->difference == 0)
+				break;
+			inside = brainfuck_flow_access(&flow, flow.position);
+			cell = brainfuck_flow_cell(&flow, flow.position);
+			value = cell->value + (iter->type == BRAINFUCK_TOKEN_PLUS ? iter->difference : -iter->difference);
+			if (cell->known && value > -2147483647L && value < 2147483647L) {
+				iter->type = BRAINFUCK_TOKEN_SET;
+				iter->difference = (int) value;
+				brainfuck_flow_store(&first, cell, iter, inside);
+			} else {
+				/* The addition reads the previous store, but may itself be overwritten */
+				cell->known = 0;
+				cell->store = inside ? iter : NULL;
+			}
+			break;
+		case BRAINFUCK_TOKEN_SET:
+			inside = brainfuck_flow_access(&flow, flow.position);
+			cell = brainfuck_flow_cell(&flow, flow.position);
+			if (inside && cell->known && cell->value == iter->difference)
+				brainfuck_unlink(&first, iter);
+			else
+				brainfuck_flow_store(&first, cell, iter, inside);
+			break;
+		case BRAINFUCK_TOKEN_INPUT:
+		case BRAINFUCK_TOKEN_COUNT:
+			brainfuck_flow_access(&flow, flow.position);
+			cell = brainfuck_flow_cell(&flow, flow.position);
+			cell->known = 0;
+			cell->store = NULL;
+			break;
+		case BRAINFUCK_TOKEN_OUTPUT:
+			brainfuck_flow_access(&flow, flow.position);
+			brainfuck_flow_cell(&flow, flow.position)->store = NULL;
+			break;
+		case BRAINFUCK_TOKEN_MULTIPLY:
+			inside = brainfuck_flow_access(&flow, flow.position);
+			cell = brainfuck_flow_cell(&flow, flow.position);
+			cell->store = NULL;
+			if (inside && cell->known && cell->value == 0) {
+				brainfuck_unlink(&first, iter);
+				break;
+			}
+			value = cell->known ? cell->value * iter->difference : 0;
+			target = brainfuck_flow_cell(&flow, flow.position + iter->offset);
+			/* The source may be forgotten when the target starts being tracked */
+			cell = brainfuck_flow_cell(&flow, flow.position);
+			value += target->value;
+			target->known = cell->known && target->known && value > -2147483647L && value < 2147483647L;
+			target->value = target->known ? value : 0;
+			target->store = NULL;
+			break;
+		case BRAINFUCK_TOKEN_NEXT:
+			flow.position += iter->difference;
+			break;
+		case BRAINFUCK_TOKEN_PREVIOUS:
+			flow.position -= iter->difference;
+			break;
+		case BRAINFUCK_TOKEN_SCAN:
+			inside = brainfuck_flow_access(&flow, flow.position);
+			cell = brainfuck_flow_cell(&flow, flow.position);
+			if (inside && cell->known && cell->value == 0)
+				brainfuck_unlink(&first, iter);
+			else
+				brainfuck_flow_reset(&flow, 1);
+			break;
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+			inside = brainfuck_flow_access(&flow, flow.position);
+			cell = brainfuck_flow_cell(&flow, flow.position);
+			if (inside && cell->known && cell->value == 0)
+				brainfuck_unlink(&first, iter);
+			else
+				brainfuck_flow_loop(&flow, iter);
+			break;
+		case BRAINFUCK_TOKEN_BREAK:
+			brainfuck_flow_read(&flow);
+			break;
+		default:
+			/* Unknown instructions end the list, as they do in brainfuck_compile */
+			return first;
+		}
+	}
+	return first;
+}
+
+/**
+ * Optimizes the given linked list of instructions in place by rewriting common
+ * 	patterns into instructions that execute faster, like loops that clear a
+ * 	cell, scan for a zero cell or add a multiple of a cell to other cells.
+ * 	Loops that run at most once become branches. From level <code>2</code>
+ * 	on, known cell values are propagated to remove loops that never run and
+ * 	stores that are never read, assuming the program starts on a zeroed tape.
+ * 	Accesses of cells that may lie off the tape are kept, so that leaving
+ * 	the tape is still reported.
+ *
+ * @param root The start of the linked list of instructions to optimize.
+ * @param level The optimization level, where <code>0</code> disables the optimizer.
+ * @return The start of the optimized linked list.
+ */
+BrainfuckInstruction * brainfuck_optimize(BrainfuckInstruction *root, int level) {
+	BrainfuckInstruction **loops;
+	size_t count, i;
+
+	if (root == NULL || level <= 0)
+		return root;
+	loops = brainfuck_collect_loops(root, &count);
+	for (i = 0; i < count; i++) {
+		if (loops[i]->type != BRAINFUCK_TOKEN_LOOP_START)
+			continue;
+		brainfuck_rewrite_idiom(loops[i]);
+		if (loops[i]->type == BRAINFUCK_TOKEN_LOOP_START)
+			brainfuck_rewrite_branch(loops[i]);
+	}
+	if (level >= 2) {
+		/* Nested bodies first, so a removed loop is never visited afterwards */
+		for (i = 0; i < count; i++)
+			loops[i]->loop = brainfuck_propagate(loops[i]->loop, 0);
+		root = brainfuck_propagate(root, 1);
+	}
+	free(loops);
+	return root;
+}
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <brainfuck.h>
+
+/* The maximum amount of commands of the source of a loop that is shown */
+#define BRAINFUCK_PROFILE_SNIPPET 40
+/* The first line of a profile, followed by the version of its format */
+#define BRAINFUCK_PROFILE_MAGIC "brainfuck-profile"
+#define BRAINFUCK_PROFILE_VERSION 1
+
+/**
+ * A loop of a profiled program together with the work done in it.
+ */
+typedef struct BrainfuckHotLoop {
+	/* The index of the operation that starts the loop */
+	size_t start;
+	/* The amount of operations executed in the loop, including its nested loops */
+	unsigned long long ops;
+	/* The amount of times the loop is entered */
+	unsigned long entries;
+	/* The amount of iterations the loop runs in total */
+	unsigned long iterations;
+} BrainfuckHotLoop;
+
+/**
+ * A scan of a profile together with how far it moved.
+ */
+typedef struct BrainfuckProfiledScan {
+	/* The position of the scan in the source */
+	BrainfuckPosition position;
+	/* The amount of times the scan is executed */
+	unsigned long executions;
+	/* The amount of strides the scan moved in total */
+	unsigned long steps;
+} BrainfuckProfiledScan;
+
+/**
+ * Orders loops by the amount of operations executed in them, the most first.
+ */
+static int brainfuck_profile_compare(const void *a, const void *b) {
+	const BrainfuckHotLoop *left = (const BrainfuckHotLoop *) a;
+	const BrainfuckHotLoop *right = (const BrainfuckHotLoop *) b;
+	if (left->ops != right->ops)
+		return left->ops < right->ops ? 1 : -1;
+	return left->start < right->start ? -1 : left->start > right->start;
+}
+
+/**
+ * Writes the commands of the loop at the given position of the source,
+ * 	leaving out comments and cutting off long loops.
+ *
+ * @param source The source of the program.
+ * @param position The position of the opening bracket of the loop.
+ * @param stream The stream to write the commands to.
+ */
+static void brainfuck_profile_snippet(const char *source, BrainfuckPosition position, FILE *stream) {
+	const char *c = source;
+	int line = 1, column = 1, depth = 0, written = 0;
+
+	for (; *c != '\0' && (line < position.line || column < position.column); c++) {
+		if (*c == '\n') {
+			if (line == position.line)
+				break;
+			line++;
+			column = 1;
+		} else {
+			column++;
+		}
+	}
+	for (; *c != '\0'; c++) {
+		switch (*c) {
+		case '[':
+			depth++;
+			break;
+		case ']':
+			depth--;
+			break;
+		case '+': case '-': case '<': case '>': case '.': case ',':
+			break;
+		default:
+			continue;
+		}
+		if (written++ == BRAINFUCK_PROFILE_SNIPPET) {
+			fputs("...", stream);
+			return;
+		}
+		fputc(*c, stream);
+		if (depth == 0)
+			return;
+	}
+}
+
+/**
+ * Writes a report of the loops the given profiled program spends the most
+ * 	operations in to the given stream, ranked by those operations and
+ * 	together with the source of the loops.
+ *
+ * @param program The program that is profiled.
+ * @param source The source the program is parsed from or <code>NULL</code>
+ * 	if it is not available, in which case only positions are reported.
+ * @param limit The maximum amount of loops to report.
+ * @param stream The stream to write the report to.
+ */
+void brainfuck_profile_report(BrainfuckProgram *program, const char *source, int limit, FILE *stream) {
+	BrainfuckHotLoop *loops;
+	BrainfuckPosition position;
+	/* The operations executed before every operation, so loops are summed in one step */
+	unsigned long long *before;
+	size_t count = 0, i, end;
+	char location[32];
+
+	if (program == NULL || program->counts == NULL)
+		return;
+	before = (unsigned long long *) malloc((program->length + 1) * sizeof(unsigned long long));
+	loops = (BrainfuckHotLoop *) malloc(program->length * sizeof(BrainfuckHotLoop));
+	before[0] = 0;
+	for (i = 0; i < program->length; i++)
+		before[i + 1] = before[i] + program->counts[i];
+	for (i = 0; i < program->length; i++) {
+		if (program->ops[i].code != BRAINFUCK_OP_LOOP_START || program->counts[i] == 0)
+			continue;
+		end = i + program->ops[i].argument;
+		loops[count].start = i;
+		loops[count].ops = before[end + 1] - before[i];
+		loops[count].entries = program->counts[i];
+		loops[count].iterations = program->counts[end];
+		count++;
+	}
+	qsort(loops, count, sizeof(BrainfuckHotLoop), &brainfuck_profile_compare);
+
+	fprintf(stream, "%llu operations executed\n", before[program->length]);
+	fprintf(stream, "%4s  %-12s %14s %7s %10s %12s  %s\n", "rank", "position", "operations", "share",
+		"entries", "iterations", "source");
+	for (i = 0; i < count && i < (size_t) limit; i++) {
+		position = program->positions[loops[i].start];
+		if (position.line > 0)
+			sprintf(location, "%d:%d", position.line, position.column);
+		else
+			sprintf(location, "-");
+		fprintf(stream, "%4zu  %-12s %14llu %6.1f%% %10lu %12lu  ", i + 1, location, loops[i].ops,
+			100.0 * (double) loops[i].ops / (double) before[program->length],
+			loops[i].entries, loops[i].iterations);
+		if (source != NULL && position.line > 0)
+			brainfuck_profile_snippet(source, position, stream);
+		fputc('\n', stream);
+	}
+	free(before);
+	free(loops);
+}
+
+/**
+ * Orders scans by their position in the source.
+ */
+static int brainfuck_profile_compare_scans(const void *a, const void *b) {
+	const BrainfuckPosition *left = &((const BrainfuckProfiledScan *) a)->position;
+	const BrainfuckPosition *right = &((const BrainfuckProfiledScan *) b)->position;
+	if (left->line != right->line)
+		return left->line < right->line ? -1 : 1;
+	return left->column < right->column ? -1 : left->column > right->column;
+}
+
+/**
+ * Writes the profile of the given profiled program to the given stream, so
+ * 	that later runs of the same source can apply it using
+ * 	<code>brainfuck_profile_apply</code>. The profile lists the entries and
+ * 	iterations of every loop, how often every branch is taken and how far
+ * 	every scan moves, keyed by their positions in the source.
+ *
+ * @param program The program that is profiled.
+ * @param stream The stream to write the profile to.
+ * @return <code>0</code> on success, otherwise <code>-1</code>.
+ */
+int brainfuck_profile_write(BrainfuckProgram *program, FILE *stream) {
+	BrainfuckOp *op;
+	BrainfuckPosition position;
+	size_t i;
+
+	if (program == NULL || program->counts == NULL)
+		return -1;
+	fprintf(stream, "%s %d\n", BRAINFUCK_PROFILE_MAGIC, BRAINFUCK_PROFILE_VERSION);
+	for (i = 0; i < program->length; i++) {
+		op = &program->ops[i];
+		position = program->positions[i];
+		/* Operations that do not stem from the source cannot be found again */
+		if (position.line <= 0)
+			continue;
+		switch (op->code) {
+		case BRAINFUCK_OP_LOOP_START:
+			fprintf(stream, "loop %d:%d %lu %lu\n", position.line, position.column,
+				program->counts[i], program->counts[i + op->argument]);
+			break;
+		case BRAINFUCK_OP_IF:
+			/* The body of a branch starts right after it */
+			fprintf(stream, "branch %d:%d %lu %lu\n", position.line, position.column,
+				program->counts[i], op->argument > 0 ? program->counts[i + 1] : 0);
+			break;
+		case BRAINFUCK_OP_SCAN_RIGHT:
+		case BRAINFUCK_OP_SCAN_LEFT:
+			fprintf(stream, "scan %d:%d %lu %lu\n", position.line, position.column,
+				program->counts[i], program->steps != NULL ? program->steps[i] : 0);
+			break;
+		default:
+			break;
+		}
+	}
+	return ferror(stream) ? -1 : 0;
+}
+
+/**
+ * Applies the profile in the given stream, written by
+ * 	<code>brainfuck_profile_write</code> for the same source, to the given
+ * 	instructions, so that compiling them specializes the program for the
+ * 	behaviour seen in the profiled run. Instructions the profile does not
+ * 	know are left alone.
+ *
+ * Only the scans make use of the profile for now: their offset is set to one
+ * 	more than the average amount of strides they moved, from which
+ * 	<code>brainfuck_compile</code> decides how to scan. Loops and branches
+ * 	are read but not used yet.
+ *
+ * @param root The start of the linked list of instructions to apply the
+ * 	profile to.
+ * @param stream The stream to read the profile from.
+ * @return <code>0</code> on success, otherwise <code>-1</code> if the profile
+ * 	is malformed.
+ */
+int brainfuck_profile_apply(BrainfuckInstruction *root, FILE *stream) {
+	BrainfuckInstruction *instruction = root, **continuations = NULL;
+	BrainfuckProfiledScan *scans = NULL, *scan, key;
+	size_t count = 0, capacity = 0, depth = 0, size = 0;
+	unsigned long first, second, distance;
+	int version, line, column, read;
+	char kind[16];
+
+	if (fscanf(stream, BRAINFUCK_PROFILE_MAGIC " %d", &version) != 1 || version != BRAINFUCK_PROFILE_VERSION)
+		return -1;
+	while ((read = fscanf(stream, " %15s %d:%d %lu %lu", kind, &line, &column, &first, &second)) == 5) {
+		if (strcmp(kind, "scan") != 0)
+			continue;
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 16;
+			scans = (BrainfuckProfiledScan *) realloc(scans, capacity * sizeof(BrainfuckProfiledScan));
+		}
+		scans[count].position.line = line;
+		scans[count].position.column = column;
+		scans[count].executions = first;
+		scans[count].steps = second;
+		count++;
+	}
+	if (read != EOF) {
+		free(scans);
+		return -1;
+	}
+	if (count > 0)
+		qsort(scans, count, sizeof(BrainfuckProfiledScan), &brainfuck_profile_compare_scans);
+
+	while (count > 0) {
+		if (instruction == NULL || instruction->type == BRAINFUCK_TOKEN_LOOP_END) {
+			if (depth == 0)
+				break;
+			instruction = continuations[--depth];
+			continue;
+		}
+		switch (instruction->type) {
+		case BRAINFUCK_TOKEN_LOOP_START:
+		case BRAINFUCK_TOKEN_IF:
+			if (depth == size) {
+				size = size ? size * 2 : 16;
+				continuations = (BrainfuckInstruction **) realloc(continuations,
+						size * sizeof(BrainfuckInstruction *));
+			}
+			continuations[depth++] = instruction->next;
+			instruction = instruction->loop;
+			continue;
+		case BRAINFUCK_TOKEN_SCAN:
+			key.position = instruction->position;
+			scan = (BrainfuckProfiledScan *) bsearch(&key, scans, count, sizeof(BrainfuckProfiledScan),
+				&brainfuck_profile_compare_scans);
+			if (scan != NULL && scan->executions > 0) {
+				distance = scan->steps / scan->executions;
+				instruction->offset = distance < INT_MAX ? (int) distance + 1 : INT_MAX;
+			}
+			break;
+		default:
+			break;
+		}
+		instruction = instruction->next;
+	}
+	free(continuations);
+	free(scans);
+	return 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _GNU_SOURCE /* memrchr */
+
+#include <string.h>
+
+#include "scan.h"
+
+/*
+ * On x86, strides of 1, 2, 4 and 8 cells are scanned 16 (SSE2) or 32 (AVX2)
+ * 	cells at a time. Since these strides divide the vector width, the cells
+ * 	to consider are at the same lanes in every vector, which are selected by
+ * 	masking the result of the comparison.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#	define BRAINFUCK_SCAN_SIMD
+#	include <immintrin.h>
+#endif
+
+#ifdef BRAINFUCK_SCAN_SIMD
+/* The lanes to consider when scanning to the right, indexed by log2(stride) */
+static const unsigned int brainfuck_lanes_right[] = { 0xFFFFFFFF, 0x55555555, 0x11111111, 0x01010101 };
+/* The lanes to consider when scanning to the left, indexed by log2(stride) */
+static const unsigned int brainfuck_lanes_left[] = { 0xFFFFFFFF, 0xAAAAAAAA, 0x88888888, 0x80808080 };
+
+/**
+ * Returns the index into the lane tables for the given stride or
+ * 	<code>-1</code> if the stride cannot be scanned using vectors.
+ */
+static int brainfuck_scan_lanes(long stride) {
+	switch (stride) {
+	case 1: return 0;
+	case 2: return 1;
+	case 4: return 2;
+	case 8: return 3;
+	default: return -1;
+	}
+}
+
+/**
+ * Determines whether the processor supports AVX2.
+ */
+static int brainfuck_has_avx2(void) {
+	static int supported = -1;
+	if (supported < 0) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("avx2") != 0;
+	}
+	return supported;
+}
+
+__attribute__((target("sse2")))
+static long brainfuck_scan_right_sse2(const unsigned char *tape, long index, long size, unsigned int lanes) {
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int mask;
+	for (; index + 16 <= size; index += 16) {
+		__m128i cells = _mm_loadu_si128((const __m128i *) (tape + index));
+		mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(cells, zero)) & lanes;
+		if (mask)
+			return index + __builtin_ctz(mask);
+	}
+	return index;
+}
+
+__attribute__((target("avx2")))
+static long brainfuck_scan_right_avx2(const unsigned char *tape, long index, long size, unsigned int lanes) {
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned int mask;
+	for (; index + 32 <= size; index += 32) {
+		__m256i cells = _mm256_loadu_si256((const __m256i *) (tape + index));
+		mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, zero)) & lanes;
+		if (mask)
+			return index + __builtin_ctz(mask);
+	}
+	return index;
+}
+
+__attribute__((target("sse2")))
+static long brainfuck_scan_left_sse2(const unsigned char *tape, long index, unsigned int lanes) {
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int mask;
+	for (; index >= 15; index -= 16) {
+		__m128i cells = _mm_loadu_si128((const __m128i *) (tape + index - 15));
+		mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(cells, zero)) & (lanes >> 16);
+		if (mask)
+			return index - 15 + (31 - __builtin_clz(mask));
+	}
+	return index;
+}
+
+__attribute__((target("avx2")))
+static long brainfuck_scan_left_avx2(const unsigned char *tape, long index, unsigned int lanes) {
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned int mask;
+	for (; index >= 31; index -= 32) {
+		__m256i cells = _mm256_loadu_si256((const __m256i *) (tape + index - 31));
+		mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, zero)) & lanes;
+		if (mask)
+			return index - 31 + (31 - __builtin_clz(mask));
+	}
+	return index;
+}
+#endif
+
+/**
+ * Finds the first zero cell at or after the given index, only considering the
+ * 	cells at a multiple of the given stride from the index.
+ *
+ * @param tape The tape to scan.
+ * @param index The index to start scanning at.
+ * @param size The size of the tape in number of cells.
+ * @param stride The distance between the cells that are considered.
+ * @return The index of the zero cell or <code>-1</code> if the scan would leave
+ * 	the tape.
+ */
+long brainfuck_scan_right(const unsigned char *tape, long index, long size, long stride) {
+#ifdef BRAINFUCK_SCAN_SIMD
+	int lanes;
+#endif
+	if (stride == 1) {
+		const unsigned char *found = memchr(tape + index, 0, size - index);
+		return found ? found - tape : -1;
+	}
+#ifdef BRAINFUCK_SCAN_SIMD
+	lanes = brainfuck_scan_lanes(stride);
+	if (lanes >= 0) {
+		if (brainfuck_has_avx2())
+			index = brainfuck_scan_right_avx2(tape, index, size, brainfuck_lanes_right[lanes]);
+		else
+			index = brainfuck_scan_right_sse2(tape, index, size, brainfuck_lanes_right[lanes]);
+	}
+#endif
+	for (; index < size; index += stride)
+		if (!tape[index])
+			return index;
+	return -1;
+}
+
+/**
+ * Finds the first zero cell at or before the given index, only considering the
+ * 	cells at a multiple of the given stride from the index.
+ *
+ * @param tape The tape to scan.
+ * @param index The index to start scanning at.
+ * @param stride The distance between the cells that are considered.
+ * @return The index of the zero cell or <code>-1</code> if the scan would leave
+ * 	the tape.
+ */
+long brainfuck_scan_left(const unsigned char *tape, long index, long stride) {
+#ifdef BRAINFUCK_SCAN_SIMD
+	int lanes;
+#endif
+#ifdef __GLIBC__
+	if (stride == 1) {
+		const unsigned char *found = memrchr(tape, 0, index + 1);
+		return found ? found - tape : -1;
+	}
+#endif
+#ifdef BRAINFUCK_SCAN_SIMD
+	lanes = brainfuck_scan_lanes(stride);
+	if (lanes >= 0) {
+		if (brainfuck_has_avx2())
+			index = brainfuck_scan_left_avx2(tape, index, brainfuck_lanes_left[lanes]);
+		else
+			index = brainfuck_scan_left_sse2(tape, index, brainfuck_lanes_left[lanes]);
+	}
+#endif
+	for (; index >= 0; index -= stride)
+		if (!tape[index])
+			return index;
+	return -1;
+}
+
+/*
+ * Wider cells are scanned one cell at a time, since programs that need them
+ * 	rarely scan long stretches of the tape.
+ */
+
+/**
+ * Finds the first zero cell at or after the given index on a tape of 16-bit
+ * 	cells, like <code>brainfuck_scan_right</code>.
+ */
+long brainfuck_scan_right_16(const uint16_t *tape, long index, long size, long stride) {
+	for (; index < size; index += stride)
+		if (!tape[index])
+			return index;
+	return -1;
+}
+
+/**
+ * Finds the first zero cell at or before the given index on a tape of 16-bit
+ * 	cells, like <code>brainfuck_scan_left</code>.
+ */
+long brainfuck_scan_left_16(const uint16_t *tape, long index, long stride) {
+	for (; index >= 0; index -= stride)
+		if (!tape[index])
+			return index;
+	return -1;
+}
+
+/**
+ * Finds the first zero cell at or after the given index on a tape of 32-bit
+ * 	cells, like <code>brainfuck_scan_right</code>.
+ */
+long brainfuck_scan_right_32(const uint32_t *tape, long index, long size, long stride) {
+	for (; index < size; index += stride)
+		if (!tape[index])
+			return index;
+	return -1;
+}
+
+/**
+ * Finds the first zero cell at or before the given index on a tape of 32-bit
+ * 	cells, like <code>brainfuck_scan_left</code>.
+ */
+long brainfuck_scan_left_32(const uint32_t *tape, long index, long stride) {
+	for (; index >= 0; index -= stride)
+		if (!tape[index])
+			return index;
+	return -1;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BRAINFUCK_SCAN_H
+#define BRAINFUCK_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Finds the first zero cell at or after the given index, only considering the
+ * 	cells at a multiple of the given stride from the index.
+ *
+ * @param tape The tape to scan.
+ * @param index The index to start scanning at.
+ * @param size The size of the tape in number of cells.
+ * @param stride The distance between the cells that are considered.
+ * @return The index of the zero cell or <code>-1</code> if the scan would leave
+ * 	the tape.
+ */
+long brainfuck_scan_right(const unsigned char *, long, long, long);
+
+/**
+ * Finds the first zero cell at or before the given index, only considering the
+ * 	cells at a multiple of the given stride from the index.
+ *
+ * @param tape The tape to scan.
+ * @param index The index to start scanning at.
+ * @param stride The distance between the cells that are considered.
+ * @return The index of the zero cell or <code>-1</code> if the scan would leave
+ * 	the tape.
+ */
+long brainfuck_scan_left(const unsigned char *, long, long);
+
+/**
+ * Finds the first zero cell at or after the given index on a tape of 16-bit
+ * 	cells, like <code>brainfuck_scan_right</code>.
+ */
+long brainfuck_scan_right_16(const uint16_t *, long, long, long);
+
+/**
+ * Finds the first zero cell at or before the given index on a tape of 16-bit
+ * 	cells, like <code>brainfuck_scan_left</code>.
+ */
+long brainfuck_scan_left_16(const uint16_t *, long, long);
+
+/**
+ * Finds the first zero cell at or after the given index on a tape of 32-bit
+ * 	cells, like <code>brainfuck_scan_right</code>.
+ */
+long brainfuck_scan_right_32(const uint32_t *, long, long, long);
+
+/**
+ * Finds the first zero cell at or before the given index on a tape of 32-bit
+ * 	cells, like <code>brainfuck_scan_left</code>.
+ */
+long brainfuck_scan_left_32(const uint32_t *, long, long);
+
+#endif /* BRAINFUCK_SCAN_H */
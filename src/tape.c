@@ -0,0 +1,267 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <brainfuck.h>
+
+#include "budget.h"
+#include "tape.h"
+
+#ifdef BRAINFUCK_TAPE_GUARD
+#	include <signal.h>
+#	include <pthread.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+/*
+ * Pages of the tape are only allocated when they are first touched, so the
+ * 	tape is not counted against the memory the system has committed to either.
+ */
+#	ifdef MAP_NORESERVE
+#		define BRAINFUCK_TAPE_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE)
+#	else
+#		define BRAINFUCK_TAPE_MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+#	endif
+
+/*
+ * Faults are raised on the thread that hits the guard region, so the recovery
+ * 	points are kept per thread and contexts can run on many threads at once.
+ */
+#	if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#		define BRAINFUCK_THREAD_LOCAL _Thread_local
+#	else
+#		define BRAINFUCK_THREAD_LOCAL __thread
+#	endif
+
+/* The recovery point of the innermost execution running on this thread */
+static BRAINFUCK_THREAD_LOCAL BrainfuckTapeRecovery *brainfuck_tape_recoveries = NULL;
+/* The overrun or underrun of the last guard region this thread hit */
+static BRAINFUCK_THREAD_LOCAL int brainfuck_tape_status = BRAINFUCK_STATUS_OK;
+/* Held while the fault handler is installed */
+static pthread_mutex_t brainfuck_handler_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Whether the fault handler is installed and the actions it replaced */
+static int brainfuck_handler_installed = 0;
+static struct sigaction brainfuck_previous_segv, brainfuck_previous_bus;
+
+/**
+ * Returns the size of the guard regions rounded up to whole pages.
+ */
+static size_t brainfuck_tape_guard_size(size_t page) {
+	return (BRAINFUCK_TAPE_GUARD_SIZE + page - 1) / page * page;
+}
+
+/**
+ * Handles a segmentation fault or bus error by returning to the recovery point
+ * 	of the execution on the faulting thread if the faulting address lies in
+ * 	the guard region of its tape. Faults only reach this handler from tape
+ * 	accesses in the executors, which hold no locks and nothing to clean up,
+ * 	so it is safe to jump out. Other faults are passed on to the actions the
+ * 	handler replaced.
+ *
+ * @param signal The signal that is raised.
+ * @param info The information about the fault.
+ * @param ucontext The machine context, which is passed on to other actions.
+ */
+static void brainfuck_tape_fault(int signal, siginfo_t *info, void *ucontext) {
+	unsigned char *address = (unsigned char *) info->si_addr, *end;
+	BrainfuckExecutionContext *context;
+	BrainfuckTapeRecovery *recovery;
+	struct sigaction *previous = signal == SIGBUS ? &brainfuck_previous_bus : &brainfuck_previous_segv;
+	size_t guard = brainfuck_tape_guard_size((size_t) sysconf(_SC_PAGESIZE));
+
+	for (recovery = brainfuck_tape_recoveries; recovery != NULL; recovery = recovery->previous) {
+		context = recovery->context;
+		end = context->tape + context->tape_size * (context->cell_width / 8);
+		if (address >= context->tape - guard && address < context->tape)
+			brainfuck_tape_status = BRAINFUCK_STATUS_UNDERRUN;
+		else if (address >= end && address < end + guard)
+			brainfuck_tape_status = BRAINFUCK_STATUS_OVERRUN;
+		else
+			continue;
+		brainfuck_tape_recoveries = recovery->previous;
+		siglongjmp(recovery->jump, 1);
+	}
+	if (previous->sa_flags & SA_SIGINFO) {
+		previous->sa_sigaction(signal, info, ucontext);
+	} else if (previous->sa_handler != SIG_DFL && previous->sa_handler != SIG_IGN) {
+		previous->sa_handler(signal);
+	} else {
+		/* Not caused by a tape, so restore the previous action and fault again */
+		sigaction(signal, previous, NULL);
+	}
+}
+#endif
+
+/**
+ * Replaces the tape of the given context by a tape of at least as many cells
+ * 	that is surrounded on both sides by <code>BRAINFUCK_TAPE_GUARD_SIZE</code>
+ * 	bytes of inaccessible memory. Accessing the guard regions is reported as
+ * 	an overrun or underrun of the tape of the context. The size of the tape is
+ * 	rounded up to a whole number of pages, so that both ends of the tape border
+ * 	a guard region.
+ * The old tape is not freed, since it is kept when the tape cannot be guarded.
+ *
+ * @param context The context to guard the tape of.
+ * @return <code>1</code> if the tape is guarded, otherwise <code>0</code>, for
+ * 	example on platforms without virtual memory protection.
+ */
+int brainfuck_tape_guard(BrainfuckExecutionContext *context) {
+#ifdef BRAINFUCK_TAPE_GUARD
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	size_t guard = brainfuck_tape_guard_size(page);
+	size_t cell = (size_t) context->cell_width / 8;
+	size_t size = (context->tape_size * cell + page - 1) / page * page;
+	struct sigaction action;
+	unsigned char *memory;
+
+	if (size == 0)
+		size = page;
+	memory = (unsigned char *) mmap(NULL, size + 2 * guard, PROT_NONE,
+		BRAINFUCK_TAPE_MAP_FLAGS, -1, 0);
+	if (memory == MAP_FAILED)
+		return 0;
+	if (mprotect(memory + guard, size, PROT_READ | PROT_WRITE) != 0) {
+		munmap(memory, size + 2 * guard);
+		return 0;
+	}
+	pthread_mutex_lock(&brainfuck_handler_lock);
+	if (!brainfuck_handler_installed) {
+		action.sa_sigaction = &brainfuck_tape_fault;
+		action.sa_flags = SA_SIGINFO;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGSEGV, &action, &brainfuck_previous_segv);
+		sigaction(SIGBUS, &action, &brainfuck_previous_bus);
+		brainfuck_handler_installed = 1;
+	}
+	pthread_mutex_unlock(&brainfuck_handler_lock);
+	context->tape = memory + guard;
+	context->tape_size = size / cell;
+	context->guarded = 1;
+	return 1;
+#else
+	(void) context;
+	return 0;
+#endif
+}
+
+/**
+ * Unmaps the guarded tape of the given context.
+ *
+ * @param context The context of which the tape is guarded.
+ */
+void brainfuck_tape_unguard(BrainfuckExecutionContext *context) {
+#ifdef BRAINFUCK_TAPE_GUARD
+	size_t guard = brainfuck_tape_guard_size((size_t) sysconf(_SC_PAGESIZE));
+	munmap(context->tape - guard, context->tape_size * (context->cell_width / 8) + 2 * guard);
+	context->tape = NULL;
+	context->guarded = 0;
+#else
+	(void) context;
+#endif
+}
+
+/**
+ * Checks whether the pointer of the given context lies on its tape, which it
+ * 	may not on guarded tapes when a program ends after moving the pointer
+ * 	without accessing the cell.
+ *
+ * @param context The context to check the pointer of.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the pointer lies on the tape,
+ * 	otherwise the overrun or underrun that is passed to
+ * 	<code>brainfuck_tape_fail</code>.
+ */
+int brainfuck_tape_check(BrainfuckExecutionContext *context) {
+	if (context->tape_index >= 0 && (size_t) context->tape_index < context->tape_size)
+		return BRAINFUCK_STATUS_OK;
+	context->position.line = 0;
+	context->position.column = 0;
+	return brainfuck_tape_fail(context, context->tape_index < 0 ?
+		BRAINFUCK_STATUS_UNDERRUN : BRAINFUCK_STATUS_OVERRUN);
+}
+
+/**
+ * Ends an execution in the given context that ran off its tape by moving the
+ * 	pointer back onto the end of the tape it ran off, so that the context
+ * 	can be used again.
+ *
+ * @param context The context of which the tape is left.
+ * @param status Either <code>BRAINFUCK_STATUS_OVERRUN</code> or
+ * 	<code>BRAINFUCK_STATUS_UNDERRUN</code>.
+ * @return The given status.
+ */
+int brainfuck_tape_fail(BrainfuckExecutionContext *context, int status) {
+	context->tape_index = status == BRAINFUCK_STATUS_OVERRUN ? (int) context->tape_size - 1 : 0;
+	return status;
+}
+
+/**
+ * Makes hitting a guard region of the tape of the given context on the
+ * 	calling thread jump to the given recovery point, which
+ * 	<code>BRAINFUCK_TAPE_RECOVER</code> sets.
+ *
+ * @param context The context of which the tape is guarded.
+ * @param recovery The point to return to.
+ */
+void brainfuck_tape_enter(BrainfuckExecutionContext *context, BrainfuckTapeRecovery *recovery) {
+#ifdef BRAINFUCK_TAPE_GUARD
+	recovery->context = context;
+	recovery->previous = brainfuck_tape_recoveries;
+	brainfuck_tape_recoveries = recovery;
+#else
+	(void) context;
+	(void) recovery;
+#endif
+}
+
+/**
+ * Forgets the recovery point of the given context, after which hitting a
+ * 	guard region of its tape is a fault again.
+ *
+ * @param context The context of which the tape is guarded.
+ */
+void brainfuck_tape_leave(BrainfuckExecutionContext *context) {
+#ifdef BRAINFUCK_TAPE_GUARD
+	if (brainfuck_tape_recoveries != NULL && brainfuck_tape_recoveries->context == context)
+		brainfuck_tape_recoveries = brainfuck_tape_recoveries->previous;
+#else
+	(void) context;
+#endif
+}
+
+/**
+ * Ends the execution in the given context that hit a guard region of its
+ * 	tape and returned to its recovery point: the budget it was handed is
+ * 	used up, the output is flushed and the pointer is moved back onto the
+ * 	tape.
+ *
+ * @param context The context of which the tape is left.
+ * @return The overrun or underrun of the tape.
+ */
+int brainfuck_tape_recovered(BrainfuckExecutionContext *context) {
+	int status = BRAINFUCK_STATUS_OVERRUN;
+#ifdef BRAINFUCK_TAPE_GUARD
+	status = brainfuck_tape_status;
+#endif
+	/* The executor that hit the guard region did not get to store its state */
+	context->position.line = 0;
+	context->position.column = 0;
+	/* Nor what is left of its budget, so the whole budget is used up */
+	context->budget = 0;
+	brainfuck_budget_settle(context);
+	brainfuck_flush(context);
+	return brainfuck_tape_fail(context, status);
+}
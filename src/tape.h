@@ -0,0 +1,138 @@
+/*
+ * Copyright 2016 Fabian Mastenbroek
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BRAINFUCK_TAPE_H
+#define BRAINFUCK_TAPE_H
+
+#include <brainfuck.h>
+
+/*
+ * Guard regions are mapped without any access rights, so that the operating
+ * 	system raises a signal when the program steps off the tape.
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#	define BRAINFUCK_TAPE_GUARD
+#	include <setjmp.h>
+#endif
+
+#ifdef BRAINFUCK_TAPE_GUARD
+/**
+ * The point an execution returns to when its program hits a guard region.
+ */
+typedef struct BrainfuckTapeRecovery {
+	/* The state of the function that runs the program */
+	sigjmp_buf jump;
+	/* The context the program runs in */
+	BrainfuckExecutionContext *context;
+	/* The recovery point of the execution on the same thread that this one runs inside of, or NULL */
+	struct BrainfuckTapeRecovery *previous;
+} BrainfuckTapeRecovery;
+
+/*
+ * Makes the function that runs a program in the given context continue at the
+ * 	given label with the overrun or underrun stored in the given status when
+ * 	the program hits a guard region of the tape of the context. Locals that
+ * 	change after this point are unspecified at the label, unless volatile.
+ * 	The recovery point has to be left using brainfuck_tape_leave.
+ */
+#	define BRAINFUCK_TAPE_RECOVER(context, recovery, status, label) \
+	if ((context)->guarded) { \
+		if (sigsetjmp((recovery).jump, 1) != 0) { \
+			(status) = brainfuck_tape_recovered(context); \
+			goto label; \
+		} \
+		brainfuck_tape_enter((context), &(recovery)); \
+	}
+#else
+typedef int BrainfuckTapeRecovery;
+#	define BRAINFUCK_TAPE_RECOVER(context, recovery, status, label) (void) (recovery)
+#endif
+
+/**
+ * Replaces the tape of the given context by a tape of at least as many cells
+ * 	that is surrounded on both sides by <code>BRAINFUCK_TAPE_GUARD_SIZE</code>
+ * 	bytes of inaccessible memory. Accessing the guard regions is reported as
+ * 	an overrun or underrun of the tape of the context. The size of the tape is
+ * 	rounded up to a whole number of pages, so that both ends of the tape border
+ * 	a guard region.
+ * The old tape is not freed, since it is kept when the tape cannot be guarded.
+ *
+ * @param context The context to guard the tape of.
+ * @return <code>1</code> if the tape is guarded, otherwise <code>0</code>, for
+ * 	example on platforms without virtual memory protection.
+ */
+int brainfuck_tape_guard(BrainfuckExecutionContext *);
+
+/**
+ * Unmaps the guarded tape of the given context.
+ *
+ * @param context The context of which the tape is guarded.
+ */
+void brainfuck_tape_unguard(BrainfuckExecutionContext *);
+
+/**
+ * Checks whether the pointer of the given context lies on its tape, which it
+ * 	may not on guarded tapes when a program ends after moving the pointer
+ * 	without accessing the cell.
+ *
+ * @param context The context to check the pointer of.
+ * @return <code>BRAINFUCK_STATUS_OK</code> if the pointer lies on the tape,
+ * 	otherwise the overrun or underrun that is passed to
+ * 	<code>brainfuck_tape_fail</code>.
+ */
+int brainfuck_tape_check(BrainfuckExecutionContext *);
+
+/**
+ * Ends an execution in the given context that ran off its tape by moving the
+ * 	pointer back onto the end of the tape it ran off, so that the context
+ * 	can be used again.
+ *
+ * @param context The context of which the tape is left.
+ * @param status Either <code>BRAINFUCK_STATUS_OVERRUN</code> or
+ * 	<code>BRAINFUCK_STATUS_UNDERRUN</code>.
+ * @return The given status.
+ */
+int brainfuck_tape_fail(BrainfuckExecutionContext *, int);
+
+/**
+ * Makes hitting a guard region of the tape of the given context on the
+ * 	calling thread jump to the given recovery point, which
+ * 	<code>BRAINFUCK_TAPE_RECOVER</code> sets.
+ *
+ * @param context The context of which the tape is guarded.
+ * @param recovery The point to return to.
+ */
+void brainfuck_tape_enter(BrainfuckExecutionContext *, BrainfuckTapeRecovery *);
+
+/**
+ * Forgets the recovery point of the given context, after which hitting a
+ * 	guard region of its tape is a fault again.
+ *
+ * @param context The context of which the tape is guarded.
+ */
+void brainfuck_tape_leave(BrainfuckExecutionContext *);
+
+/**
+ * Ends the execution in the given context that hit a guard region of its
+ * 	tape and returned to its recovery point: the budget it was handed is
+ * 	used up, the output is flushed and the pointer is moved back onto the
+ * 	tape.
+ *
+ * @param context The context of which the tape is left.
+ * @return The overrun or underrun of the tape.
+ */
+int brainfuck_tape_recovered(BrainfuckExecutionContext *);
+
+#endif /* BRAINFUCK_TAPE_H */
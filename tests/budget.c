@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+#include "executors.h"
+
+/* Counts to 256 in the first cell, which runs the loop 255 times unless optimized */
+#define FINITE "+[+]"
+
+/**
+ * Runs the given code with the given fuel and timeout using the given
+ * executor and verifies that it ends with the expected status.
+ */
+static int check(const TestExecutor *executor, char *code, int level, long long fuel, long timeout, int stop, int expected) {
+	BrainfuckInstruction *instructions = brainfuck_optimize(brainfuck_parse_string(code), level);
+	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	int result = 1, status;
+
+	context->fuel = fuel;
+	brainfuck_set_timeout(context, timeout);
+	if (stop)
+		brainfuck_execution_stop(context);
+	status = executor->execute(instructions, context);
+	if (status != expected) {
+		fprintf(stderr, "%s: %s ended with status %d instead of %d\n", executor->kind, code, status, expected);
+		result = 0;
+	} else if (status == BRAINFUCK_STATUS_OK && fuel >= 0 && (context->fuel <= 0 || context->fuel >= fuel)) {
+		fprintf(stderr, "%s: %s left %lld of %lld fuel\n", executor->kind, code, context->fuel, fuel);
+		result = 0;
+	}
+	brainfuck_destroy_context(context);
+	brainfuck_destroy_instructions(instructions);
+	return result;
+}
+
+/**
+ * Runs the checks for the given executor.
+ */
+static int check_executor(const TestExecutor *executor) {
+	int result = 1;
+	result &= check(executor, FINITE, 0, -1, 0, 0, BRAINFUCK_STATUS_OK);
+	result &= check(executor, FINITE, 0, 10000, 0, 0, BRAINFUCK_STATUS_OK);
+	result &= check(executor, FINITE, 0, 100, 0, 0, BRAINFUCK_STATUS_BUDGET);
+	result &= check(executor, "+[]", 0, 100000, 0, 0, BRAINFUCK_STATUS_BUDGET);
+	result &= check(executor, "+[]", 0, -1, 50, 0, BRAINFUCK_STATUS_BUDGET);
+	result &= check(executor, "+[]", 0, -1, 0, 1, BRAINFUCK_STATUS_STOPPED);
+	/* Loops that never reach zero are counted in a single operation once optimized */
+	result &= check(executor, "+[--]", 1, 100000, 0, 0, BRAINFUCK_STATUS_BUDGET);
+	return result;
+}
+
+/**
+ * Test verifying that every executor stops programs that are stopped, run
+ * out of fuel or pass their deadline, and runs other programs to their end.
+ */
+int main() {
+	int result = 1;
+	size_t i;
+	for (i = 0; i < EXECUTOR_COUNT; i++)
+		result &= check_executor(&executors[i]);
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <brainfuck.h>
+
+/*
+ * Multiplies 8 by 8 and the result by 4, which wraps around to zero only on
+ * 8-bit cells, decrements a zero cell and finally scans to the right for a
+ * zero cell, which stops at the product on 8-bit cells.
+ */
+#define PROGRAM "++++++++[->++++++++<]>[->++++<]>>-<<<+>+<[>]"
+
+/**
+ * Returns the value of the cell at the given index of the tape of the context.
+ */
+static unsigned long cell(BrainfuckExecutionContext *context, int index) {
+	uint16_t wide;
+	uint32_t wider;
+	switch (context->cell_width) {
+	case 16:
+		memcpy(&wide, context->tape + index * 2, sizeof(wide));
+		return wide;
+	case 32:
+		memcpy(&wider, context->tape + index * 4, sizeof(wider));
+		return wider;
+	default:
+		return context->tape[index];
+	}
+}
+
+/**
+ * Verifies that the program wrapped its cells around at the width of the cells
+ * of the given context.
+ */
+static int verify(char *kind, int width, BrainfuckExecutionContext *context) {
+	unsigned long mask = width == 32 ? 0xFFFFFFFFUL : (1UL << width) - 1;
+	if (context->tape_index != (width == 8 ? 2 : 4) || cell(context, 0) != 1 ||
+			cell(context, 1) != 1 || cell(context, 2) != (256 & mask) || cell(context, 3) != mask) {
+		fprintf(stderr, "%s tape mismatch for %d-bit cells\n", kind, width);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Runs the program on a tape of cells of the given width with every executor,
+ * on a regular and a guarded tape.
+ */
+static int check(BrainfuckInstruction *root, BrainfuckProgram *program, int width) {
+	BrainfuckExecutionContext *contexts[] = {
+		brainfuck_context(BRAINFUCK_TAPE_SIZE), brainfuck_context(BRAINFUCK_TAPE_SIZE),
+		brainfuck_context(BRAINFUCK_TAPE_SIZE), brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE),
+		brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE), brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE)
+	};
+	int result = 1, i;
+
+	for (i = 0; i < 6; i++) {
+		if (!brainfuck_set_cell_width(contexts[i], width)) {
+			fprintf(stderr, "%d-bit cells are not supported\n", width);
+			result = 0;
+		}
+	}
+	brainfuck_execute(root, contexts[0]);
+	result &= verify("list", width, contexts[0]);
+	brainfuck_execute_program(program, contexts[1]);
+	result &= verify("compiled", width, contexts[1]);
+	brainfuck_execute_jit(root, contexts[2]);
+	result &= verify("jit", width, contexts[2]);
+	brainfuck_execute(root, contexts[3]);
+	result &= verify("guarded list", width, contexts[3]);
+	brainfuck_execute_program(program, contexts[4]);
+	result &= verify("guarded", width, contexts[4]);
+	brainfuck_execute_jit(root, contexts[5]);
+	result &= verify("guarded jit", width, contexts[5]);
+	for (i = 0; i < 6; i++)
+		brainfuck_destroy_context(contexts[i]);
+	return result;
+}
+
+/**
+ * Test verifying that every executor supports 8, 16 and 32-bit cells.
+ */
+int main() {
+	BrainfuckState *state = brainfuck_state();
+	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckProgram *program;
+	int result = 1;
+
+	brainfuck_add(state, brainfuck_optimize(brainfuck_parse_string(PROGRAM), 1));
+	program = brainfuck_compile(state->root);
+	result &= check(state->root, program, 8);
+	result &= check(state->root, program, 16);
+	result &= check(state->root, program, 32);
+	if (brainfuck_set_cell_width(context, 12)) {
+		fprintf(stderr, "12-bit cells are accepted\n");
+		result = 0;
+	}
+
+	brainfuck_destroy_program(program);
+	brainfuck_destroy_context(context);
+	brainfuck_destroy_state(state);
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+static char code[4096];
+
+/**
+ * Translates the given program into C code and verifies that the code contains
+ * the given statement and that its braces are balanced.
+ */
+static int check(char *program, char *statement) {
+	BrainfuckInstruction *instructions = brainfuck_optimize(brainfuck_parse_string(program),
+		BRAINFUCK_OPTIMIZE_DEFAULT);
+	FILE *stream = tmpfile();
+	size_t length, index;
+	int depth = 0, result = 1;
+
+	if (instructions == NULL || stream == NULL || brainfuck_emit_c(instructions, stream) != 0) {
+		fprintf(stderr, "failed to emit %s\n", program);
+		return 0;
+	}
+	rewind(stream);
+	length = fread(code, 1, sizeof(code) - 1, stream);
+	code[length] = '\0';
+	fclose(stream);
+	brainfuck_destroy_instructions(instructions);
+
+	if (strstr(code, statement) == NULL) {
+		fprintf(stderr, "missing \"%s\" for %s\n", statement, program);
+		result = 0;
+	}
+	for (index = 0; index < length; index++)
+		depth += code[index] == '{' ? 1 : code[index] == '}' ? -1 : 0;
+	if (depth != 0) {
+		fprintf(stderr, "unbalanced braces for %s\n", program);
+		result = 0;
+	}
+	return result;
+}
+
+/**
+ * Test verifying that programs are translated into the expected C statements.
+ */
+int main() {
+	int result = 1;
+	result &= check("+++[>++<-]>.", "p[1] += *p * 2;");
+	result &= check("+[>.<-]", "while (*p) {");
+	result &= check("+[>[-]+[.-]<-]", "\t\twhile (*p) {");
+	result &= check(">>>+[<]", "if ((p -= 1) < tape) underrun();");
+	result &= check("[-],", "*p = 0;");
+	result &= check("[]+++.", "*p += 3;");
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
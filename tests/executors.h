@@ -0,0 +1,37 @@
+#ifndef BRAINFUCK_TESTS_EXECUTORS_H
+#define BRAINFUCK_TESTS_EXECUTORS_H
+
+#include <brainfuck.h>
+
+/**
+ * An executor that the tests run their programs with.
+ */
+typedef struct TestExecutor {
+	/* The name of the executor in failure messages */
+	char *kind;
+	/* Runs the given instructions in the given context and returns the status */
+	int (*execute)(BrainfuckInstruction *, BrainfuckExecutionContext *);
+	/* Whether moves are folded into the operation that accesses the cell */
+	int folded;
+} TestExecutor;
+
+/**
+ * Executes the given instructions as compiled program.
+ */
+static int execute_program(BrainfuckInstruction *root, BrainfuckExecutionContext *context) {
+	BrainfuckProgram *program = brainfuck_compile(root);
+	int status = brainfuck_execute_program(program, context);
+	brainfuck_destroy_program(program);
+	return status;
+}
+
+/* Every executor, which tests should behave the same */
+static const TestExecutor executors[] = {
+	{ "list", &brainfuck_execute, 0 },
+	{ "compiled", &execute_program, 1 },
+	{ "jit", &brainfuck_execute_jit, 1 }
+};
+
+#define EXECUTOR_COUNT (sizeof(executors) / sizeof(executors[0]))
+
+#endif /* BRAINFUCK_TESTS_EXECUTORS_H */
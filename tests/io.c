@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+#include "executors.h"
+
+static const char input[] = { 'a', (char) 0xFF, '\n', 'b' };
+static size_t input_position;
+
+static char output[64];
+static size_t output_length;
+
+static long read_block(char *buffer, size_t length) {
+	/* Hand out the input in small blocks to exercise refilling the buffer */
+	if (length > 3)
+		length = 3;
+	if (length > sizeof(input) - input_position)
+		length = sizeof(input) - input_position;
+	memcpy(buffer, input + input_position, length);
+	input_position += length;
+	return (long) length;
+}
+
+static long write_block(const char *buffer, size_t length) {
+	if (length > sizeof(output) - output_length)
+		length = sizeof(output) - output_length;
+	memcpy(output + output_length, buffer, length);
+	output_length += length;
+	return (long) length;
+}
+
+/**
+ * Runs a program echoing one byte more than the input contains using the given
+ * executor and verifies that all bytes, including 0xFF, are read as is and that
+ * the end of the input leaves the cell unchanged.
+ */
+static int check(const TestExecutor *executor) {
+	static const char expected[] = { 'a', (char) 0xFF, '\n', 'b', 'b' };
+	BrainfuckInstruction *instructions = brainfuck_parse_string(",.,.,.,.,.");
+	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	int result = 1;
+
+	context->read_handler = &read_block;
+	context->write_handler = &write_block;
+	input_position = 0;
+	output_length = 0;
+	executor->execute(instructions, context);
+
+	if (output_length != sizeof(expected) || memcmp(output, expected, output_length) != 0) {
+		fprintf(stderr, "%s output mismatch\n", executor->kind);
+		result = 0;
+	}
+	brainfuck_destroy_context(context);
+	brainfuck_destroy_instructions(instructions);
+	return result;
+}
+
+/**
+ * Test verifying that buffered input is binary-safe for every executor.
+ */
+int main() {
+	int result = 1;
+	size_t i;
+	for (i = 0; i < EXECUTOR_COUNT; i++)
+		result &= check(&executors[i]);
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
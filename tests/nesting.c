@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <brainfuck.h>
+
+/* The nesting depth of the loops in the generated program */
+#define DEPTH 300000
+
+/**
+ * Generates the source of the program <code>+[[[...-...]]]>+</code> with the
+ * given nesting depth.
+ */
+static char * generate(int depth) {
+	char *source = (char *) malloc(2 * depth + 5);
+	int i;
+
+	source[0] = '+';
+	for (i = 0; i < depth; i++) {
+		source[1 + i] = '[';
+		source[2 + depth + i] = ']';
+	}
+	source[1 + depth] = '-';
+	source[2 + 2 * depth] = '>';
+	source[3 + 2 * depth] = '+';
+	source[4 + 2 * depth] = '\0';
+	return source;
+}
+
+/**
+ * Verifies that the program left the tape in the expected state.
+ */
+static int verify(char *kind, BrainfuckExecutionContext *context) {
+	if (context->tape_index != 1 || context->tape[0] != 0 || context->tape[1] != 1) {
+		fprintf(stderr, "%s tape mismatch\n", kind);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Verifies that unbalanced brackets are rejected and that parsing into an
+ * arena reports the given bracket at the given line and column.
+ */
+static int reject(char *code, char bracket, int line, int column) {
+	BrainfuckInstruction *root = brainfuck_parse_string(code);
+	BrainfuckArena *arena = brainfuck_arena();
+	int result = 1;
+	if (root != NULL) {
+		fprintf(stderr, "accepted unbalanced brackets in %s\n", code);
+		brainfuck_destroy_instructions(root);
+		result = 0;
+	}
+	if (brainfuck_arena_parse_string(arena, code) != NULL || arena->unmatched != bracket ||
+			arena->unmatched_position.line != line || arena->unmatched_position.column != column) {
+		fprintf(stderr, "%s did not report unmatched '%c' at %d:%d\n", code, bracket, line, column);
+		result = 0;
+	}
+	brainfuck_destroy_arena(arena);
+	return result;
+}
+
+/**
+ * Stress test verifying that the parser and executors handle loops nested
+ * hundreds of thousands of levels deep.
+ */
+int main() {
+	char *source = generate(DEPTH);
+	BrainfuckArena *arena = brainfuck_arena();
+	BrainfuckInstruction *root = brainfuck_arena_parse_string(arena, source);
+	BrainfuckExecutionContext *list = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *compiled = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *jit = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckProgram *program = brainfuck_compile(root);
+	int result = 1;
+
+	brainfuck_execute(root, list);
+	result &= verify("list", list);
+	brainfuck_execute_program(program, compiled);
+	result &= verify("compiled", compiled);
+	brainfuck_execute_jit(root, jit);
+	result &= verify("jit", jit);
+
+	/* Instructions that are not allocated from an arena are freed one by one */
+	brainfuck_destroy_instructions(brainfuck_parse_string(source));
+	result &= reject("+[[-]>+", '[', 1, 2);
+	result &= reject("+[-]]>+", ']', 1, 5);
+	result &= reject("]", ']', 1, 1);
+	result &= reject("]+++.", ']', 1, 1);
+	result &= reject("++[>++<-", '[', 1, 3);
+	result &= reject("+\n[-\n]]", ']', 3, 2);
+
+	brainfuck_destroy_program(program);
+	brainfuck_destroy_context(list);
+	brainfuck_destroy_context(compiled);
+	brainfuck_destroy_context(jit);
+	brainfuck_destroy_arena(arena);
+	free(source);
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+static char output[1024];
+static size_t output_length;
+
+static int capture(int chr) {
+	if (output_length < sizeof(output))
+		output[output_length++] = (char) chr;
+	return chr;
+}
+
+/**
+ * Runs the given program with and without optimizations at the given level and
+ * verifies that both produce the same output and final tape. The optimized
+ * program is allocated from an arena.
+ */
+static int check_level(char *code, int level) {
+	char expected[sizeof(output)];
+	size_t expected_length;
+	BrainfuckInstruction *plain = brainfuck_parse_string(code);
+	BrainfuckArena *arena = brainfuck_arena();
+	BrainfuckInstruction *optimized = brainfuck_optimize(brainfuck_arena_parse_string(arena, code), level);
+	BrainfuckExecutionContext *reference = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckProgram *program = brainfuck_compile(optimized);
+	int result = 1;
+
+	reference->output_handler = context->output_handler = &capture;
+
+	output_length = 0;
+	brainfuck_execute(plain, reference);
+	memcpy(expected, output, output_length);
+	expected_length = output_length;
+
+	output_length = 0;
+	brainfuck_execute_program(program, context);
+
+	if (output_length != expected_length || memcmp(output, expected, output_length) != 0) {
+		fprintf(stderr, "output mismatch for %s at level %d\n", code, level);
+		result = 0;
+	}
+	if (reference->tape_index != context->tape_index ||
+			memcmp(reference->tape, context->tape, reference->tape_size) != 0) {
+		fprintf(stderr, "tape mismatch for %s at level %d\n", code, level);
+		result = 0;
+	}
+	brainfuck_destroy_program(program);
+	brainfuck_destroy_context(reference);
+	brainfuck_destroy_context(context);
+	brainfuck_destroy_instructions(plain);
+	brainfuck_destroy_instructions(optimized);
+	brainfuck_destroy_arena(arena);
+	return result;
+}
+
+/**
+ * Runs the given program at every optimization level.
+ */
+static int check(char *code) {
+	return check_level(code, 1) & check_level(code, 2);
+}
+
+/**
+ * Verifies that the given program is optimized into a single instruction of
+ * the given type.
+ */
+static int check_idiom(char *code, char type) {
+	BrainfuckInstruction *root = brainfuck_optimize(brainfuck_parse_string(code), BRAINFUCK_OPTIMIZE_DEFAULT);
+	int result = root->type == type;
+	if (!result)
+		fprintf(stderr, "%s was not rewritten\n", code);
+	brainfuck_destroy_instructions(root);
+	return result;
+}
+
+/**
+ * Verifies that propagating known cell values leaves the given program with a
+ * set instruction of the given value as its first instruction.
+ */
+static int check_dataflow(char *code, int value) {
+	BrainfuckInstruction *root = brainfuck_optimize(brainfuck_parse_string(code), 2);
+	int result = root->type == BRAINFUCK_TOKEN_SET && root->difference == value;
+	if (!result)
+		fprintf(stderr, "%s was not folded into %d\n", code, value);
+	brainfuck_destroy_instructions(root);
+	return result;
+}
+
+/**
+ * Verifies that the given program still leaves a tape of the given size with
+ * the expected status at every optimization level, even though the cells it
+ * leaves the tape at are never changed.
+ */
+static int check_bounds(char *code, int size, int expected) {
+	BrainfuckInstruction *root;
+	BrainfuckExecutionContext *context;
+	BrainfuckProgram *program;
+	int result = 1, level, status;
+
+	for (level = 1; level <= 2; level++) {
+		root = brainfuck_optimize(brainfuck_parse_string(code), level);
+		context = brainfuck_context(size);
+		program = brainfuck_compile(root);
+		context->output_handler = &capture;
+		status = brainfuck_execute_program(program, context);
+		if (status != expected) {
+			fprintf(stderr, "%s ended with status %d instead of %d at level %d\n", code, status, expected, level);
+			result = 0;
+		}
+		brainfuck_destroy_program(program);
+		brainfuck_destroy_context(context);
+		brainfuck_destroy_instructions(root);
+	}
+	return result;
+}
+
+/**
+ * Test verifying that the optimizer rewrites loop idioms without changing the
+ * behaviour of programs.
+ */
+int main() {
+	int result = 1;
+	result &= check_idiom("[-]", BRAINFUCK_TOKEN_SET);
+	result &= check_idiom("[+++]", BRAINFUCK_TOKEN_SET);
+	result &= check_idiom("[>>>>]", BRAINFUCK_TOKEN_SCAN);
+	result &= check_idiom("[<]", BRAINFUCK_TOKEN_SCAN);
+	result &= check_idiom("[->+>++<<]", BRAINFUCK_TOKEN_MULTIPLY);
+	result &= check_idiom("[>+<+]", BRAINFUCK_TOKEN_MULTIPLY);
+	result &= check_idiom("[--->+<]", BRAINFUCK_TOKEN_COUNT);
+	result &= check_idiom("[>+++<++++++]", BRAINFUCK_TOKEN_COUNT);
+	result &= check_idiom("[>+<[-]]", BRAINFUCK_TOKEN_IF);
+	result &= check_idiom("[>.[<]]", BRAINFUCK_TOKEN_IF);
+	result &= check("++++++++[>++++[>++>+++>+++>+<<<<-]>+>+>->>+[<]<-]>>.>---.+++++++..+++.>>.<-.<.++"
+	                "+.------.--------.>>+.>++.");
+	result &= check("+++++[->+++>--<<]>[-]>.<<.");
+	result &= check("++++[+>+<]>.");
+	result &= check(">>>+>+>+<<<<+[>]>+.<<+[<]>.");
+	result &= check("+>>>+>>>+>>>>+<<<<<<<<<<[>>>]>.");
+	result &= check("+++[>+++[>++<-]<-]>>.");
+	result &= check("+++++[--->++>-<<]>.>.");
+	result &= check("+>+<[>>+<[->+<]<[-]]>>.>[<<+>>[-]>+<]<<.>>>.");
+	result &= check_dataflow("[comment, with. commands]++-+.", 2);
+	result &= check_dataflow("+++[-]+.", 1);
+	result &= check_dataflow("[-][.][>+<-]++.", 2);
+	result &= check_bounds("<[-]>+++.", BRAINFUCK_TAPE_SIZE, BRAINFUCK_STATUS_UNDERRUN);
+	result &= check_bounds("+<[>]>+->[+>]>>.<-[+>]", BRAINFUCK_TAPE_SIZE, BRAINFUCK_STATUS_UNDERRUN);
+	result &= check_bounds(">>>>[-]<<<<+.", 4, BRAINFUCK_STATUS_OVERRUN);
+	result &= check_bounds(">>>>[<]<<<<+.", 4, BRAINFUCK_STATUS_OVERRUN);
+	result &= check("++++++++[>+++++<++++++]>.");
+	result &= check("-[>+<-----]>.<++++++++++++++++++++++++++++++++++++++++++++++++[>--<----------------]>.");
+	result &= check("[.]+++[>++<-]>[<+>-]+<[>.<-]>>[<]+++[-]>[-]+<.>.[-]++.");
+	result &= check(">++>+++[<]>[-]<[>]+>>[-]<<[->+<]>.>.<<+++++[>>[-]<<-]");
+	result &= check("++++++++++++++++++++++++++++++++++++[-->+++<]>.<++++++++[--------]");
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+/* Runs the inner loop twice for each of the three iterations of the outer loop */
+#define PROGRAM "+++\n[>++[>+<-]<-]>>."
+/* Scans two cells to the right and then 32 cells to the left */
+#define SCANS "+>+>+<<[>]\n>++++++++++++++++++++++++++++++++[[>+<-]+>-]<[<]"
+
+static int discard(int chr) {
+	return chr;
+}
+
+/**
+ * Finds the first scan operation of the given program after the given index.
+ */
+static size_t find_scan(BrainfuckProgram *program, size_t from) {
+	size_t i;
+	for (i = from; i < program->length; i++) {
+		if (program->ops[i].code == BRAINFUCK_OP_SCAN_RIGHT || program->ops[i].code == BRAINFUCK_OP_SCAN_LEFT)
+			break;
+	}
+	return i;
+}
+
+/**
+ * Profiles a program with a short and a long scan, applies the written
+ * profile to the program parsed anew and verifies that the short scan probes
+ * more cells, the long scan none and that the program still computes the same.
+ */
+static int check_feedback() {
+	BrainfuckInstruction *root = brainfuck_optimize(brainfuck_parse_string(SCANS), BRAINFUCK_OPTIMIZE_DEFAULT);
+	BrainfuckProgram *program = brainfuck_compile(root), *applied;
+	BrainfuckExecutionContext *context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	FILE *stream = tmpfile();
+	size_t short_scan, long_scan;
+	int result = 1;
+
+	brainfuck_profile_program(program, context);
+	brainfuck_destroy_context(context);
+	if (brainfuck_profile_write(program, stream) != 0) {
+		fprintf(stderr, "failed to write the profile\n");
+		result = 0;
+	}
+	brainfuck_destroy_instructions(root);
+
+	rewind(stream);
+	root = brainfuck_optimize(brainfuck_parse_string(SCANS), BRAINFUCK_OPTIMIZE_DEFAULT);
+	if (brainfuck_profile_apply(root, stream) != 0) {
+		fprintf(stderr, "failed to apply the profile\n");
+		result = 0;
+	}
+	applied = brainfuck_compile(root);
+	short_scan = find_scan(applied, 0);
+	long_scan = find_scan(applied, short_scan + 1);
+	if (long_scan >= applied->length || applied->length != program->length ||
+			applied->ops[short_scan].offset <= program->ops[short_scan].offset ||
+			applied->ops[long_scan].offset != 0) {
+		fprintf(stderr, "scans are not specialized for the profile\n");
+		result = 0;
+	}
+	context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	brainfuck_execute_program(applied, context);
+	if (context->tape_index != 3) {
+		fprintf(stderr, "program with profile applied ended at %d instead of 3\n", context->tape_index);
+		result = 0;
+	}
+	brainfuck_destroy_context(context);
+	brainfuck_destroy_program(applied);
+	brainfuck_destroy_program(program);
+
+	/* Malformed profiles are rejected */
+	fclose(stream);
+	stream = tmpfile();
+	fputs("brainfuck-profile 1\nscan 1:8 2\n", stream);
+	rewind(stream);
+	if (brainfuck_profile_apply(root, stream) != -1) {
+		fprintf(stderr, "malformed profile is accepted\n");
+		result = 0;
+	}
+	fclose(stream);
+	brainfuck_destroy_instructions(root);
+	return result;
+}
+
+/**
+ * Test verifying that profiling counts the iterations of every loop, that the
+ * operations know the source positions of their instructions and that the
+ * report shows the hottest loop with its source, and that a written profile
+ * can be fed back into compilation.
+ */
+int main() {
+	BrainfuckInstruction *root = brainfuck_parse_string(PROGRAM);
+	BrainfuckProgram *program = brainfuck_compile(root);
+	BrainfuckExecutionContext *context;
+	size_t loops[2], count = 0, i;
+	char report[1024];
+	FILE *stream = tmpfile();
+	int result = 1, run;
+
+	for (i = 0; i < program->length && count < 2; i++) {
+		if (program->ops[i].code == BRAINFUCK_OP_LOOP_START)
+			loops[count++] = i;
+	}
+	if (count != 2 || program->positions[loops[0]].line != 2 || program->positions[loops[0]].column != 1 ||
+			program->positions[loops[1]].line != 2 || program->positions[loops[1]].column != 5) {
+		fprintf(stderr, "loops do not know their source positions\n");
+		result = 0;
+	}
+
+	/* Profiling twice adds up the counts */
+	for (run = 0; run < 2; run++) {
+		context = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+		context->output_handler = &discard;
+		brainfuck_profile_program(program, context);
+		if (context->tape_index != 2 || context->tape[2] != 6) {
+			fprintf(stderr, "profiled program computed the wrong result\n");
+			result = 0;
+		}
+		brainfuck_destroy_context(context);
+	}
+	if (result && (program->counts[loops[0]] != 2 ||
+			program->counts[loops[0] + program->ops[loops[0]].argument] != 6 ||
+			program->counts[loops[1]] != 6 ||
+			program->counts[loops[1] + program->ops[loops[1]].argument] != 12)) {
+		fprintf(stderr, "loop iterations are counted wrongly\n");
+		result = 0;
+	}
+
+	brainfuck_profile_report(program, PROGRAM, 1, stream);
+	rewind(stream);
+	memset(report, 0, sizeof(report));
+	if (fread(report, 1, sizeof(report) - 1, stream) == 0 || strstr(report, "2:1") == NULL ||
+			strstr(report, "[>++[>+<-]<-]") == NULL || strstr(report, "2:5") != NULL) {
+		fprintf(stderr, "report does not rank the outer loop first:\n%s", report);
+		result = 0;
+	}
+	fclose(stream);
+
+	brainfuck_destroy_program(program);
+	brainfuck_destroy_instructions(root);
+	result &= check_feedback();
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
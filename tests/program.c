@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+static char output[1024];
+static size_t output_length;
+
+static int capture(int chr) {
+	if (output_length < sizeof(output))
+		output[output_length++] = (char) chr;
+	return chr;
+}
+
+static long capture_block(const char *buffer, size_t length) {
+	size_t kept = length;
+	/* Output that does not fit is dropped, since failing to write it ends the program */
+	if (kept > sizeof(output) - output_length)
+		kept = sizeof(output) - output_length;
+	memcpy(output + output_length, buffer, kept);
+	output_length += kept;
+	return (long) length;
+}
+
+/**
+ * Verifies that the given context ended up in the same state as the reference.
+ */
+static int compare(char *code, char *kind, char *expected, size_t expected_length,
+		BrainfuckExecutionContext *reference, BrainfuckExecutionContext *context) {
+	int result = 1;
+	if (output_length != expected_length || memcmp(output, expected, output_length) != 0) {
+		fprintf(stderr, "%s output mismatch for %s\n", kind, code);
+		result = 0;
+	}
+	if (reference->tape_index != context->tape_index ||
+			memcmp(reference->tape, context->tape, reference->tape_size) != 0) {
+		fprintf(stderr, "%s tape mismatch for %s\n", kind, code);
+		result = 0;
+	}
+	return result;
+}
+
+/**
+ * Runs the given program as linked list, as compiled program and as machine
+ * code, with and without buffering the output and on a guarded tape, and
+ * verifies that all produce the same output and final tape.
+ */
+static int check(char *code) {
+	char expected[sizeof(output)];
+	size_t expected_length;
+	BrainfuckState *state = brainfuck_state();
+	BrainfuckExecutionContext *list = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *compiled = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *jit = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *buffered = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *buffered_jit = brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *guarded_list = brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *guarded = brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckExecutionContext *guarded_jit = brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE);
+	BrainfuckProgram *program;
+	int result = 1;
+
+	brainfuck_add(state, brainfuck_parse_string(code));
+	if (state->root == NULL) {
+		fprintf(stderr, "failed to parse %s\n", code);
+		result = 0;
+	}
+	list->output_handler = compiled->output_handler = jit->output_handler = &capture;
+	guarded_list->output_handler = guarded->output_handler = guarded_jit->output_handler = &capture;
+	buffered->write_handler = buffered_jit->write_handler = &capture_block;
+
+	output_length = 0;
+	brainfuck_execute(state->root, list);
+	memcpy(expected, output, output_length);
+	expected_length = output_length;
+
+	output_length = 0;
+	program = brainfuck_compile(state->root);
+	brainfuck_execute_program(program, compiled);
+	result &= compare(code, "compiled", expected, expected_length, list, compiled);
+
+	output_length = 0;
+	brainfuck_execute_jit(state->root, jit);
+	result &= compare(code, "jit", expected, expected_length, list, jit);
+
+	output_length = 0;
+	brainfuck_execute_program(program, buffered);
+	result &= compare(code, "buffered", expected, expected_length, list, buffered);
+
+	output_length = 0;
+	brainfuck_execute_jit(state->root, buffered_jit);
+	result &= compare(code, "buffered jit", expected, expected_length, list, buffered_jit);
+
+	output_length = 0;
+	brainfuck_execute(state->root, guarded_list);
+	result &= compare(code, "guarded list", expected, expected_length, list, guarded_list);
+
+	output_length = 0;
+	brainfuck_execute_program(program, guarded);
+	result &= compare(code, "guarded", expected, expected_length, list, guarded);
+
+	output_length = 0;
+	brainfuck_execute_jit(state->root, guarded_jit);
+	result &= compare(code, "guarded jit", expected, expected_length, list, guarded_jit);
+
+	brainfuck_destroy_program(program);
+	brainfuck_destroy_context(list);
+	brainfuck_destroy_context(compiled);
+	brainfuck_destroy_context(jit);
+	brainfuck_destroy_context(buffered);
+	brainfuck_destroy_context(buffered_jit);
+	brainfuck_destroy_context(guarded_list);
+	brainfuck_destroy_context(guarded);
+	brainfuck_destroy_context(guarded_jit);
+	brainfuck_destroy_state(state);
+	return result;
+}
+
+/**
+ * Test verifying that compiled programs and machine code behave like the linked
+ * list they are compiled from.
+ */
+int main() {
+	int result = 1;
+	result &= check("++++++++[>++++[>++>+++>+++>+<<<<-]>+>+>->>+[<]<-]>>.>---.+++++++..+++.>>.<-.<.++"
+	                "+.------.--------.>>+.>++.");
+	result &= check("+++[>+++[>+++<-]<-]>>[-<+>]<.");
+	result &= check("+-+-><><>>+<<[]..");
+	result &= check("-[>-[>-<-]<-]>>.");
+	result &= check("[]+++.");
+	result &= check("++[>++<-]");
+	result &= check("-[>.....................<-]");
+	result &= check(">>>++[<+<+[>>>+<<<-]>>-]<<[>+<<+>-]>>>.");
+	result &= check("+>++>+++<<.>.>.<[-]<-.>>+.[<+>-]<<.>");
+	result &= check("+++++[--->++>-<<]>.>.<<++++++++[>>+++<<----]>>.");
+	result &= check(">>+[>+>[-<+>]<<[-]]>>.<<[>>++<<[-]]>.<+++[>>+>[<]>[-]<<-]>>>.");
+	result &= check("+>++>+++<<[>>>+>[-]>+[<]>[>>+<<[-]]<<<[-]]>>>>.>.<<.");
+	result &= check("++[>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>"
+		">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>+++.<<<<<<<<"
+		"<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<"
+		"<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<-]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>"
+		">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>-.");
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
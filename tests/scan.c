@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+#define TAPE_SIZE 1000
+
+/**
+ * Scans the given tape using the given loop both with and without
+ * optimizations and verifies that the scans end at the same cell.
+ */
+static int check(char *code, unsigned char *cells, int start) {
+	BrainfuckInstruction *plain = brainfuck_parse_string(code);
+	BrainfuckInstruction *optimized = brainfuck_optimize(brainfuck_parse_string(code), BRAINFUCK_OPTIMIZE_DEFAULT);
+	BrainfuckProgram *program = brainfuck_compile(optimized);
+	BrainfuckExecutionContext *reference = brainfuck_context(TAPE_SIZE);
+	BrainfuckExecutionContext *context = brainfuck_context(TAPE_SIZE);
+	int result = 1;
+
+	memcpy(reference->tape, cells, TAPE_SIZE);
+	memcpy(context->tape, cells, TAPE_SIZE);
+	reference->tape_index = context->tape_index = start;
+	brainfuck_execute(plain, reference);
+	brainfuck_execute_program(program, context);
+	if (reference->tape_index != context->tape_index) {
+		fprintf(stderr, "%s from %d ended at %d instead of %d\n", code, start,
+			context->tape_index, reference->tape_index);
+		result = 0;
+	}
+	brainfuck_destroy_program(program);
+	brainfuck_destroy_context(reference);
+	brainfuck_destroy_context(context);
+	brainfuck_destroy_instructions(plain);
+	brainfuck_destroy_instructions(optimized);
+	return result;
+}
+
+/**
+ * Test verifying that scan loops of various strides find the same zero cell
+ * as the loops they are rewritten from.
+ */
+int main() {
+	unsigned char cells[TAPE_SIZE];
+	char right[16], left[16];
+	int result = 1, stride, zero, i;
+
+	for (stride = 1; stride <= 9; stride++) {
+		right[0] = left[0] = '[';
+		memset(right + 1, '>', stride);
+		memset(left + 1, '<', stride);
+		right[stride + 1] = left[stride + 1] = ']';
+		right[stride + 2] = left[stride + 2] = '\0';
+
+		for (zero = 0; zero < TAPE_SIZE; zero += 7) {
+			/* Zero cells that are not a multiple of the stride away must be skipped */
+			memset(cells, 1, TAPE_SIZE);
+			for (i = 1; i < TAPE_SIZE; i += 5)
+				if ((i - zero) % stride != 0)
+					cells[i] = 0;
+			cells[zero] = 0;
+			result &= check(right, cells, zero % stride);
+			result &= check(left, cells, zero + (TAPE_SIZE - 1 - zero) / stride * stride);
+		}
+	}
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
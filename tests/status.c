@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <brainfuck.h>
+
+#include "executors.h"
+
+/* The kinds of contexts the programs run in */
+#define PLAIN 0
+#define GUARDED 1
+
+/* The fuel the programs start with, of which the loops use at least one for every cell they pass */
+#define FUEL (1LL << 40)
+
+static int failing_output(int chr) {
+	(void) chr;
+	return EOF;
+}
+
+static long failing_read(char *buffer, size_t length) {
+	(void) buffer;
+	(void) length;
+	return -1;
+}
+
+/**
+ * Runs the given code using the given executor and verifies that it ends with
+ * the expected status at the expected line and column, or at an unknown
+ * position if it hit a guard region, that its loops used fuel and that the
+ * context can run another program afterwards.
+ */
+static int check(const TestExecutor *executor, int guarded, char *code, int expected, int line, int column) {
+	BrainfuckInstruction *instructions = brainfuck_parse_string(code);
+	BrainfuckInstruction *next = brainfuck_parse_string("+");
+	BrainfuckExecutionContext *context = guarded ? brainfuck_guarded_context(BRAINFUCK_TAPE_SIZE) :
+		brainfuck_context(BRAINFUCK_TAPE_SIZE);
+	int result = 1, status;
+
+	context->output_handler = &failing_output;
+	context->read_handler = &failing_read;
+	context->fuel = FUEL;
+	status = executor->execute(instructions, context);
+	if (status != expected) {
+		fprintf(stderr, "%s: %s ended with status %d instead of %d\n", executor->kind, code, status, expected);
+		result = 0;
+	} else if ((context->position.line != line || context->position.column != column) &&
+			(!guarded || context->position.line != 0)) {
+		fprintf(stderr, "%s: %s failed at %d:%d instead of %d:%d\n", executor->kind, code,
+			context->position.line, context->position.column, line, column);
+		result = 0;
+	} else if (strchr(code, '[') != NULL && FUEL - context->fuel < (long long) context->tape_size) {
+		fprintf(stderr, "%s: %s left %lld of %lld fuel\n", executor->kind, code, context->fuel, FUEL);
+		result = 0;
+	} else if (context->tape_index < 0 || (size_t) context->tape_index >= context->tape_size) {
+		fprintf(stderr, "%s: %s left the pointer off the tape\n", executor->kind, code);
+		result = 0;
+	} else if ((status = executor->execute(next, context)) != BRAINFUCK_STATUS_OK) {
+		fprintf(stderr, "%s: %s left a context that ends with status %d\n", executor->kind, code, status);
+		result = 0;
+	}
+	brainfuck_destroy_context(context);
+	brainfuck_destroy_instructions(instructions);
+	brainfuck_destroy_instructions(next);
+	return result;
+}
+
+/**
+ * Runs the checks for the given executor, which reports leaving the tape at
+ * the operation that accesses the cell if it folds moves into it.
+ */
+static int check_executor(const TestExecutor *executor) {
+	int folded = executor->folded, result = 1;
+	result &= check(executor, PLAIN, "+\n[>+]", BRAINFUCK_STATUS_OVERRUN, 2, folded ? 3 : 2);
+	result &= check(executor, PLAIN, "+\n <+", BRAINFUCK_STATUS_UNDERRUN, 2, folded ? 3 : 2);
+	result &= check(executor, GUARDED, "+\n[>+]", BRAINFUCK_STATUS_OVERRUN, 2, folded ? 3 : 2);
+	result &= check(executor, GUARDED, "+\n <+", BRAINFUCK_STATUS_UNDERRUN, 2, folded ? 3 : 2);
+	/* Mixed runs merge into a single move against the direction of its first command */
+	result &= check(executor, PLAIN, "+\n[<>>+]", BRAINFUCK_STATUS_OVERRUN, 2, folded ? 5 : 2);
+	result &= check(executor, PLAIN, "+\n><<+", BRAINFUCK_STATUS_UNDERRUN, 2, folded ? 4 : 1);
+	result &= check(executor, PLAIN, "+\n .", BRAINFUCK_STATUS_IO, 2, 2);
+	result &= check(executor, PLAIN, "+\n ,", BRAINFUCK_STATUS_IO, 2, 2);
+	return result;
+}
+
+/**
+ * Test verifying that every executor reports leaving the tape and failing
+ * input and output by its status instead of ending the process.
+ */
+int main() {
+	int result = 1;
+	size_t i;
+	for (i = 0; i < EXECUTOR_COUNT; i++)
+		result &= check_executor(&executors[i]);
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
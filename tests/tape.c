@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <brainfuck.h>
+
+/* The distance between the cells the program touches */
+#define DISTANCE 300000000
+
+/**
+ * Verifies that the program touched the cells far to the left and right of
+ * where the pointer started.
+ */
+static int verify(char *kind, BrainfuckExecutionContext *context) {
+	long start = (long) context->tape_size / 2;
+	if (context->tape_index != start + DISTANCE || context->tape[start - DISTANCE] != 1 ||
+			context->tape[start + DISTANCE] != 2 || context->tape[start] != 0) {
+		fprintf(stderr, "%s tape mismatch\n", kind);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Test verifying that sparse tapes let programs move far in both directions.
+ */
+int main() {
+	BrainfuckInstruction *root = brainfuck_instruction(BRAINFUCK_TOKEN_PREVIOUS, DISTANCE);
+	BrainfuckExecutionContext *list = brainfuck_sparse_context(-1);
+	BrainfuckExecutionContext *compiled = brainfuck_sparse_context(-1);
+	BrainfuckExecutionContext *jit = brainfuck_sparse_context(-1);
+	BrainfuckProgram *program;
+	int result = 1;
+
+	root->next = brainfuck_instruction(BRAINFUCK_TOKEN_PLUS, 1);
+	root->next->next = brainfuck_instruction(BRAINFUCK_TOKEN_NEXT, 2 * DISTANCE);
+	root->next->next->next = brainfuck_instruction(BRAINFUCK_TOKEN_PLUS, 2);
+	program = brainfuck_compile(root);
+
+	brainfuck_execute(root, list);
+	result &= verify("list", list);
+	brainfuck_execute_program(program, compiled);
+	result &= verify("compiled", compiled);
+	brainfuck_execute_jit(root, jit);
+	result &= verify("jit", jit);
+
+	brainfuck_destroy_program(program);
+	brainfuck_destroy_instructions(root);
+	brainfuck_destroy_context(list);
+	brainfuck_destroy_context(compiled);
+	brainfuck_destroy_context(jit);
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}